@@ -7,6 +7,7 @@ contains($$list($$[QT_VERSION]),4.[6-9].*) {
 }
 
 the_includes.files += QMimeDatabase \
+                      QMimeDataSniffer \
                       QMimeType \
 
 unix:!symbian {
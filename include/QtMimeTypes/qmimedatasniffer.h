@@ -0,0 +1 @@
+#include "../../src/mimetypes/qmimedatasniffer.h"
@@ -89,6 +89,8 @@ QT_BEGIN_NAMESPACE
            files should be written. For instance unix local sockets.
     \value ConfigLocation Returns a directory location where user-specific
            configuration files should be written.
+    \value GenericCacheLocation Returns a directory location where user-specific
+           non-essential (cached) data, shared across applications, should be written.
 
 
     \sa writableLocation(), standardLocations(), displayName(), locate(), locateAll()
@@ -80,6 +80,7 @@ OSType translateLocation(QStandardPaths::StandardLocation type)
     case QStandardPaths::DataLocation:
         return kApplicationSupportFolderType;
     case QStandardPaths::CacheLocation:
+    case QStandardPaths::GenericCacheLocation:
         return kCachedDataFolderType;
     default:
         return kDesktopFolderType;
@@ -126,6 +127,7 @@ QString QStandardPaths::writableLocation(StandardLocation type)
     case GenericDataLocation:
     case DataLocation:
     case CacheLocation:
+    case GenericCacheLocation:
     case RuntimeLocation:
         return macLocation(type, kUserDomain);
     default:
@@ -65,15 +65,18 @@ QString QStandardPaths::writableLocation(StandardLocation type)
     case TempLocation:
         return QDir::tempPath();
     case CacheLocation:
+    case GenericCacheLocation:
     {
         // http://standards.freedesktop.org/basedir-spec/basedir-spec-0.6.html
         QString xdgCacheHome = QLatin1String(qgetenv("XDG_CACHE_HOME"));
         if (xdgCacheHome.isEmpty())
             xdgCacheHome = QDir::homePath() + QLatin1String("/.cache");
-        if (!QCoreApplication::organizationName().isEmpty())
-            xdgCacheHome += QLatin1Char('/') + QCoreApplication::organizationName();
-        if (!QCoreApplication::applicationName().isEmpty())
-            xdgCacheHome += QLatin1Char('/') + QCoreApplication::applicationName();
+        if (type == QStandardPaths::CacheLocation) {
+            if (!QCoreApplication::organizationName().isEmpty())
+                xdgCacheHome += QLatin1Char('/') + QCoreApplication::organizationName();
+            if (!QCoreApplication::applicationName().isEmpty())
+                xdgCacheHome += QLatin1Char('/') + QCoreApplication::applicationName();
+        }
         return xdgCacheHome;
     }
     case DataLocation:
@@ -28,25 +28,42 @@ QT     = core
 QMAKE_CXXFLAGS += -W -Wall -Wextra -Wshadow -Wnon-virtual-dtor
 
 SOURCES += qmimedatabase.cpp \
+           qmimedatasniffer.cpp \
            qmimetype.cpp \
+           qmimetypeprivate.cpp \
            qmimemagicrulematcher.cpp \
+           qmimemagicdispatchindex.cpp \
+           qmimemagicruleprogram.cpp \
+           qmimemagicstringscanner.cpp \
+           qmimemagicsubstring.cpp \
            qmimetypeparser.cpp \
+           qmimexmlpackage.cpp \
            qmimemagicrule.cpp \
            qmimeglobpattern.cpp \
-           qmimeprovider.cpp
+           qmimeprovider.cpp \
+           qmimecachewriter.cpp \
+           qmimewatcher.cpp
 
 the_includes.files += qmime_global.h \
                       qmimedatabase.h \
+                      qmimedatasniffer.h \
                       qmimetype.h \
 
 HEADERS += $$the_includes.files \
            qmimemagicrulematcher_p.h \
+           qmimemagicdispatchindex_p.h \
+           qmimemagicruleprogram_p.h \
+           qmimemagicstringscanner_p.h \
+           qmimemagicsubstring_p.h \
            qmimetype_p.h \
            qmimetypeparser_p.h \
+           qmimexmlpackage_p.h \
            qmimedatabase_p.h \
            qmimemagicrule_p.h \
            qmimeglobpattern_p.h \
-           qmimeprovider_p.h
+           qmimeprovider_p.h \
+           qmimecachewriter_p.h \
+           qmimewatcher_p.h
 
 SOURCES += inqt5/qstandardpaths.cpp
 win32: SOURCES += inqt5/qstandardpaths_win.cpp
@@ -59,8 +76,25 @@ unix: {
     }
 }
 
-RESOURCES += \
-    mimetypes.qrc
+qmime_no_builtin_database {
+    DEFINES += QMIME_NO_BUILTIN_DATABASE
+    RESOURCES += \
+        mimetypes.qrc
+} else {
+    # freedesktop.org.xml is serialized into the library by qmimedatabasegen (see src/tools).
+    # When cross-compiling, pass one built for the host: qmake QMIME_DATABASEGEN=<path>
+    isEmpty(QMIME_DATABASEGEN) {
+        QMIME_DATABASEGEN = $$OUT_PWD/../../bin/qmimedatabasegen
+        win32: QMIME_DATABASEGEN = $${QMIME_DATABASEGEN}.exe
+    }
+    BUILTIN_DATABASE = mime/packages/freedesktop.org.xml
+    qmimedatabasegen.input = BUILTIN_DATABASE
+    qmimedatabasegen.output = qmimebuiltindatabase.cpp
+    qmimedatabasegen.commands = $$QMIME_DATABASEGEN ${QMAKE_FILE_NAME} ${QMAKE_FILE_OUT}
+    qmimedatabasegen.depends = $$QMIME_DATABASEGEN
+    qmimedatabasegen.variable_out = SOURCES
+    QMAKE_EXTRA_COMPILERS += qmimedatabasegen
+}
 
 symbian {
     MMP_RULES += EXPORTUNFROZEN
@@ -0,0 +1,486 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtCore module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qmimecachewriter_p.h"
+
+#include "qmimeprovider_p.h"
+
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QHash>
+#include <QtCore/QSet>
+#include <QtCore/QTemporaryFile>
+#include <QtCore/QXmlStreamWriter>
+#include <QtCore/QtEndian>
+
+#include <stdio.h>
+
+QT_BEGIN_NAMESPACE
+
+void QMimeCacheWriter::addMimeType(const QMimeTypePrivate &data)
+{
+    MimeTypeData &mimeType = m_mimeTypes[data.name];
+    mimeType.localeComments = data.localeComments;
+    mimeType.genericIconName = data.genericIconName;
+    mimeType.iconName = data.iconName;
+    mimeType.globPatterns = data.globPatterns;
+}
+
+void QMimeCacheWriter::addGlobPattern(const QMimeGlobPattern &glob)
+{
+    m_globs.append(glob);
+}
+
+void QMimeCacheWriter::addParent(const QString &child, const QString &parent)
+{
+    QList<QByteArray> &parents = m_parents[child.toUtf8()];
+    const QByteArray parentName = parent.toUtf8();
+    if (!parents.contains(parentName))
+        parents.append(parentName);
+}
+
+void QMimeCacheWriter::addAlias(const QString &alias, const QString &name)
+{
+    m_aliases.insert(alias.toUtf8(), name.toUtf8());
+}
+
+void QMimeCacheWriter::addMagicMatcher(const QMimeMagicRuleMatcher &matcher)
+{
+    m_magicMatchers.append(matcher);
+}
+
+// Position of the "list offsets" values, at the beginning of the mime.cache file
+enum {
+    PosAliasListOffset = 4,
+    PosParentListOffset = 8,
+    PosLiteralListOffset = 12,
+    PosReverseSuffixTreeOffset = 16,
+    PosGlobListOffset = 20,
+    PosMagicListOffset = 24,
+    PosNamespaceListOffset = 28,
+    PosIconsListOffset = 32,
+    PosGenericIconsListOffset = 36,
+    HeaderSize = 40
+};
+
+namespace {
+
+// The mime.cache being written: big endian, with 4-byte aligned lists and shared strings
+class CacheBuffer
+{
+public:
+    int reserve(int size)
+    {
+        const int offset = m_data.size();
+        m_data.append(QByteArray(size, '\0'));
+        return offset;
+    }
+
+    void setUint32(int offset, quint32 value)
+    {
+        qToBigEndian(value, reinterpret_cast<uchar *>(m_data.data() + offset));
+    }
+
+    // Also used for the magic values and masks, which may contain '\0'
+    int string(const QByteArray &str)
+    {
+        QHash<QByteArray, int>::const_iterator it = m_strings.constFind(str);
+        if (it != m_strings.constEnd())
+            return it.value();
+        const int offset = m_data.size();
+        m_data.append(str);
+        m_data.append('\0');
+        while (m_data.size() % 4)
+            m_data.append('\0');
+        m_strings.insert(str, offset);
+        return offset;
+    }
+
+    const QByteArray &data() const { return m_data; }
+
+private:
+    QByteArray m_data;
+    QHash<QByteArray, int> m_strings;
+};
+
+struct SuffixNode
+{
+    ~SuffixNode() { qDeleteAll(children); }
+
+    QMap<uint, SuffixNode *> children;
+    QList<QPair<QByteArray, quint32> > leaves; // mime type, weight and flags
+};
+
+} // namespace
+
+static inline quint32 globFlagsAndWeight(const QMimeGlobPattern &glob)
+{
+    return (glob.weight() & 0xff) | (glob.isCaseSensitive() ? 0x100 : 0);
+}
+
+static inline bool hasWildcards(const QString &pattern, int from = 0)
+{
+    for (int i = from; i < pattern.length(); ++i) {
+        const QChar ch = pattern.at(i);
+        if (ch == QLatin1Char('*') || ch == QLatin1Char('?') || ch == QLatin1Char('['))
+            return true;
+    }
+    return false;
+}
+
+// Writes the entries of a node of the reverse suffix tree, leaves first, and
+// returns the offset of the first one
+static int writeSuffixNodes(CacheBuffer &buffer, const SuffixNode &node)
+{
+    const int first = buffer.reserve(12 * (node.leaves.count() + node.children.count()));
+    int offset = first;
+    for (int i = 0; i < node.leaves.count(); ++i, offset += 12) {
+        buffer.setUint32(offset + 4, buffer.string(node.leaves.at(i).first));
+        buffer.setUint32(offset + 8, node.leaves.at(i).second);
+    }
+    for (QMap<uint, SuffixNode *>::const_iterator it = node.children.constBegin(); it != node.children.constEnd(); ++it, offset += 12) {
+        const SuffixNode &child = *it.value();
+        const int firstChild = writeSuffixNodes(buffer, child);
+        buffer.setUint32(offset, it.key());
+        buffer.setUint32(offset + 4, child.leaves.count() + child.children.count());
+        buffer.setUint32(offset + 8, firstChild);
+    }
+    return first;
+}
+
+static QList<QMimeMagicRule> validRules(const QList<QMimeMagicRule> &rules)
+{
+    QList<QMimeMagicRule> result;
+    foreach (const QMimeMagicRule &rule, rules) {
+        if (rule.isValid())
+            result.append(rule);
+    }
+    return result;
+}
+
+// Writes the matchlets of \a rules, and their children, and returns the offset
+// of the first one. The extent is the number of bytes they look at.
+static int writeMatchlets(CacheBuffer &buffer, const QList<QMimeMagicRule> &rules, int *extent)
+{
+    const int first = buffer.reserve(32 * rules.count());
+    for (int i = 0; i < rules.count(); ++i) {
+        const QMimeMagicRule &rule = rules.at(i);
+        const int offset = first + 32 * i;
+        const QByteArray value = rule.matchValue();
+        const QByteArray mask = rule.matchMask();
+        const int rangeLength = rule.endPos() - rule.startPos() + 1;
+        const int wordSize = rule.type() == QMimeMagicRule::Host16 ? 2 : rule.type() == QMimeMagicRule::Host32 ? 4 : 1;
+        buffer.setUint32(offset, rule.startPos());
+        buffer.setUint32(offset + 4, rangeLength);
+        buffer.setUint32(offset + 8, wordSize);
+        buffer.setUint32(offset + 12, value.size());
+        buffer.setUint32(offset + 16, buffer.string(value));
+        // No mask at all when it keeps every bit, as written by update-mime-database
+        if (mask.count(char(0xff)) != mask.size())
+            buffer.setUint32(offset + 20, buffer.string(mask));
+        *extent = qMax(*extent, rule.startPos() + rangeLength - 1 + value.size());
+
+        const QList<QMimeMagicRule> children = validRules(rule.m_subMatches);
+        if (!children.isEmpty()) {
+            const int firstChild = writeMatchlets(buffer, children, extent);
+            buffer.setUint32(offset + 24, children.count());
+            buffer.setUint32(offset + 28, firstChild);
+        }
+    }
+    return first;
+}
+
+// The first matches are tried first: by decreasing priority, then by name
+static bool magicMatcherLessThan(const QMimeMagicRuleMatcher &m1, const QMimeMagicRuleMatcher &m2)
+{
+    if (m1.priority() != m2.priority())
+        return m1.priority() > m2.priority();
+    return m1.mimetype().toUtf8() < m2.mimetype().toUtf8();
+}
+
+static int writeIconsList(CacheBuffer &buffer, const QMap<QByteArray, QByteArray> &icons)
+{
+    const int list = buffer.reserve(4 + 8 * icons.count());
+    buffer.setUint32(list, icons.count());
+    int offset = list + 4;
+    for (QMap<QByteArray, QByteArray>::const_iterator it = icons.constBegin(); it != icons.constEnd(); ++it, offset += 8) {
+        buffer.setUint32(offset, buffer.string(it.key()));
+        buffer.setUint32(offset + 4, buffer.string(it.value()));
+    }
+    return list;
+}
+
+/*!
+    \internal
+    Returns the mime.cache file, version 1.2, as described in the shared-mime-info
+    specification and read by QMimeBinaryProvider.
+*/
+QByteArray QMimeCacheWriter::mimeCache() const
+{
+    CacheBuffer buffer;
+    buffer.reserve(HeaderSize);
+    buffer.setUint32(0, 0x00010002); // major and minor version
+
+    // Aliases, sorted by alias
+    const int aliasList = buffer.reserve(4 + 8 * m_aliases.count());
+    buffer.setUint32(PosAliasListOffset, aliasList);
+    buffer.setUint32(aliasList, m_aliases.count());
+    int offset = aliasList + 4;
+    for (QMap<QByteArray, QByteArray>::const_iterator it = m_aliases.constBegin(); it != m_aliases.constEnd(); ++it, offset += 8) {
+        buffer.setUint32(offset, buffer.string(it.key()));
+        buffer.setUint32(offset + 4, buffer.string(it.value()));
+    }
+
+    // Parents, sorted by child
+    const int parentList = buffer.reserve(4 + 8 * m_parents.count());
+    buffer.setUint32(PosParentListOffset, parentList);
+    buffer.setUint32(parentList, m_parents.count());
+    offset = parentList + 4;
+    for (QMap<QByteArray, QList<QByteArray> >::const_iterator it = m_parents.constBegin(); it != m_parents.constEnd(); ++it, offset += 8) {
+        const QList<QByteArray> &parents = it.value();
+        const int parentsOffset = buffer.reserve(4 + 4 * parents.count());
+        buffer.setUint32(parentsOffset, parents.count());
+        for (int i = 0; i < parents.count(); ++i)
+            buffer.setUint32(parentsOffset + 4 + 4 * i, buffer.string(parents.at(i)));
+        buffer.setUint32(offset, buffer.string(it.key()));
+        buffer.setUint32(offset + 4, parentsOffset);
+    }
+
+    // Globs: literals, simple "*.suffix" patterns in the reverse suffix tree, the others in a list
+    QMap<QByteArray, QMimeGlobPattern> literals; // sorted by literal
+    QList<QMimeGlobPattern> globs;
+    SuffixNode suffixTree;
+    QSet<QString> seenGlobs;
+    foreach (const QMimeGlobPattern &glob, m_globs) {
+        // The binary provider matches case-insensitive globs against the lowercased file name
+        const QString pattern = glob.isCaseSensitive() ? glob.pattern() : glob.pattern().toLower();
+        const QString key = pattern + QLatin1Char('\0') + glob.mimeType() + QLatin1Char(glob.isCaseSensitive() ? 's' : 'i');
+        if (seenGlobs.contains(key))
+            continue; // e.g. in a package file and in an override
+        seenGlobs.insert(key);
+        if (!hasWildcards(pattern)) {
+            literals.insertMulti(pattern.toUtf8(), glob);
+        } else if (pattern.length() > 1 && pattern.at(0) == QLatin1Char('*') && !hasWildcards(pattern, 1)) {
+            SuffixNode *node = &suffixTree;
+            for (int i = pattern.length() - 1; i > 0; --i) {
+                SuffixNode *&child = node->children[pattern.at(i).unicode()];
+                if (!child)
+                    child = new SuffixNode;
+                node = child;
+            }
+            node->leaves.append(qMakePair(glob.mimeType().toUtf8(), globFlagsAndWeight(glob)));
+        } else {
+            globs.append(glob);
+        }
+    }
+
+    const int literalList = buffer.reserve(4 + 12 * literals.count());
+    buffer.setUint32(PosLiteralListOffset, literalList);
+    buffer.setUint32(literalList, literals.count());
+    offset = literalList + 4;
+    for (QMap<QByteArray, QMimeGlobPattern>::const_iterator it = literals.constBegin(); it != literals.constEnd(); ++it, offset += 12) {
+        buffer.setUint32(offset, buffer.string(it.key()));
+        buffer.setUint32(offset + 4, buffer.string(it.value().mimeType().toUtf8()));
+        buffer.setUint32(offset + 8, globFlagsAndWeight(it.value()));
+    }
+
+    const int suffixTreeHeader = buffer.reserve(8);
+    buffer.setUint32(PosReverseSuffixTreeOffset, suffixTreeHeader);
+    const int firstRoot = writeSuffixNodes(buffer, suffixTree);
+    buffer.setUint32(suffixTreeHeader, suffixTree.children.count());
+    buffer.setUint32(suffixTreeHeader + 4, firstRoot);
+
+    const int globList = buffer.reserve(4 + 12 * globs.count());
+    buffer.setUint32(PosGlobListOffset, globList);
+    buffer.setUint32(globList, globs.count());
+    offset = globList + 4;
+    foreach (const QMimeGlobPattern &glob, globs) {
+        buffer.setUint32(offset, buffer.string(glob.pattern().toUtf8()));
+        buffer.setUint32(offset + 4, buffer.string(glob.mimeType().toUtf8()));
+        buffer.setUint32(offset + 8, globFlagsAndWeight(glob));
+        offset += 12;
+    }
+
+    // Magic
+    QList<QMimeMagicRuleMatcher> matchers = m_magicMatchers;
+    qStableSort(matchers.begin(), matchers.end(), magicMatcherLessThan);
+    const int magicList = buffer.reserve(12);
+    buffer.setUint32(PosMagicListOffset, magicList);
+    const int firstMatch = buffer.reserve(16 * matchers.count());
+    int maxExtent = 0;
+    for (int i = 0; i < matchers.count(); ++i) {
+        const QMimeMagicRuleMatcher &matcher = matchers.at(i);
+        const QList<QMimeMagicRule> rules = validRules(matcher.magicRules());
+        const int firstMatchlet = writeMatchlets(buffer, rules, &maxExtent);
+        offset = firstMatch + 16 * i;
+        buffer.setUint32(offset, matcher.priority());
+        buffer.setUint32(offset + 4, buffer.string(matcher.mimetype().toUtf8()));
+        buffer.setUint32(offset + 8, rules.count());
+        buffer.setUint32(offset + 12, firstMatchlet);
+    }
+    buffer.setUint32(magicList, matchers.count());
+    buffer.setUint32(magicList + 4, maxExtent);
+    buffer.setUint32(magicList + 8, firstMatch);
+
+    // No namespaces: they are not part of the XML files
+    const int namespaceList = buffer.reserve(4);
+    buffer.setUint32(PosNamespaceListOffset, namespaceList);
+
+    QMap<QByteArray, QByteArray> icons;
+    QMap<QByteArray, QByteArray> genericIcons;
+    for (QMap<QString, MimeTypeData>::const_iterator it = m_mimeTypes.constBegin(); it != m_mimeTypes.constEnd(); ++it) {
+        if (!it.value().iconName.isEmpty())
+            icons.insert(it.key().toUtf8(), it.value().iconName.toUtf8());
+        if (!it.value().genericIconName.isEmpty())
+            genericIcons.insert(it.key().toUtf8(), it.value().genericIconName.toUtf8());
+    }
+    buffer.setUint32(PosIconsListOffset, writeIconsList(buffer, icons));
+    buffer.setUint32(PosGenericIconsListOffset, writeIconsList(buffer, genericIcons));
+
+    return buffer.data();
+}
+
+/*!
+    \internal
+    Returns the XML file of the type \a name, as written by update-mime-database
+    and read by QMimeBinaryProvider::loadMimeTypeXml().
+*/
+QByteArray QMimeCacheWriter::mimeTypeXml(const QString &name, const MimeTypeData &data) const
+{
+    QByteArray xml;
+    QXmlStreamWriter writer(&xml);
+    writer.setAutoFormatting(true);
+    writer.writeStartDocument();
+    writer.writeStartElement(QLatin1String("mime-type"));
+    writer.writeDefaultNamespace(QLatin1String("http://www.freedesktop.org/standards/shared-mime-info"));
+    writer.writeAttribute(QLatin1String("type"), name);
+
+    QStringList languages = data.localeComments.keys();
+    languages.sort();
+    foreach (const QString &language, languages) {
+        writer.writeStartElement(QLatin1String("comment"));
+        if (language != QLatin1String("en_US"))
+            writer.writeAttribute(QLatin1String("xml:lang"), language);
+        writer.writeCharacters(data.localeComments.value(language));
+        writer.writeEndElement();
+    }
+    if (!data.iconName.isEmpty()) {
+        writer.writeEmptyElement(QLatin1String("icon"));
+        writer.writeAttribute(QLatin1String("name"), data.iconName);
+    }
+    if (!data.genericIconName.isEmpty()) {
+        writer.writeEmptyElement(QLatin1String("generic-icon"));
+        writer.writeAttribute(QLatin1String("name"), data.genericIconName);
+    }
+    foreach (const QString &pattern, data.globPatterns) {
+        writer.writeEmptyElement(QLatin1String("glob"));
+        writer.writeAttribute(QLatin1String("pattern"), pattern);
+    }
+
+    writer.writeEndElement();
+    writer.writeEndDocument();
+    return xml;
+}
+
+// Replaces \a fileName at once, so that readers never see a partial file. On Unix,
+// rename() overwrites it atomically; elsewhere it is briefly missing in between.
+static bool writeFile(const QString &fileName, const QByteArray &data, QString *errorMessage)
+{
+    QTemporaryFile file(fileName + QLatin1String(".XXXXXX"));
+    if (file.open() && file.write(data) == data.size() && file.flush()) {
+#ifdef Q_OS_UNIX
+        if (::rename(QFile::encodeName(file.fileName()).constData(), QFile::encodeName(fileName).constData()) == 0) {
+#else
+        QFile::remove(fileName);
+        if (file.rename(fileName)) {
+#endif
+            file.setAutoRemove(false);
+            return true;
+        }
+    }
+    if (errorMessage)
+        *errorMessage = QString::fromLatin1("Cannot write %1: %2").arg(fileName, file.errorString());
+    return false;
+}
+
+/*!
+    \internal
+    Writes the files into \a mimeDir, mime.cache last: the files it refers to
+    are in place when the binary provider notices it changed.
+*/
+bool QMimeCacheWriter::write(const QString &mimeDir, QString *errorMessage) const
+{
+    QDir dir;
+    QByteArray types;
+    for (QMap<QString, MimeTypeData>::const_iterator it = m_mimeTypes.constBegin(); it != m_mimeTypes.constEnd(); ++it) {
+        const QString fileName = mimeDir + QLatin1Char('/') + it.key() + QLatin1String(".xml");
+        if (!dir.mkpath(QFileInfo(fileName).absolutePath())) {
+            if (errorMessage)
+                *errorMessage = QString::fromLatin1("Cannot create the directory of %1").arg(fileName);
+            return false;
+        }
+        if (!writeFile(fileName, mimeTypeXml(it.key(), it.value()), errorMessage))
+            return false;
+        types += it.key().toUtf8() + '\n';
+    }
+
+    return writeFile(mimeDir + QLatin1String("/types"), types, errorMessage)
+        && writeFile(mimeDir + QLatin1String("/mime.cache"), mimeCache(), errorMessage);
+}
+
+/*!
+    \internal
+    Does what "update-mime-database \a mimeDir" does for the binary provider: compiles
+    the XML files of \a mimeDir/packages into \a mimeDir/mime.cache.
+*/
+QMIME_EXPORT bool qmime_updateMimeDatabase(const QString &mimeDir, QString *errorMessage) // exported for the unit test
+{
+    QMimeXMLProvider provider(0);
+    const QDir packageDir(mimeDir + QLatin1String("/packages"));
+    foreach (const QString &file, packageDir.entryList(QDir::Files, QDir::Name)) {
+        if (!provider.load(packageDir.filePath(file), errorMessage))
+            return false;
+    }
+    return provider.writeMimeCache(mimeDir, errorMessage);
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,93 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtCore module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QMIMECACHEWRITER_P_H
+#define QMIMECACHEWRITER_P_H
+
+#include "qmimeglobpattern_p.h"
+#include "qmimemagicrulematcher_p.h"
+#include "qmimetype_p.h"
+
+#include <QtCore/qmap.h>
+#include <QtCore/qstringlist.h>
+
+QT_BEGIN_NAMESPACE
+
+/*
+   Writes the files update-mime-database writes for the binary provider: mime.cache,
+   "types" and the XML file of each type, from what the XML provider parsed.
+   The other files (globs2, magic, subclasses...) are not written: the binary
+   provider doesn't read them.
+ */
+class QMimeCacheWriter
+{
+public:
+    void addMimeType(const QMimeTypePrivate &data);
+    void addGlobPattern(const QMimeGlobPattern &glob);
+    void addParent(const QString &child, const QString &parent);
+    void addAlias(const QString &alias, const QString &name);
+    void addMagicMatcher(const QMimeMagicRuleMatcher &matcher);
+
+    bool write(const QString &mimeDir, QString *errorMessage) const;
+
+private:
+    struct MimeTypeData
+    {
+        QMimeTypePrivate::LocaleHash localeComments;
+        QString genericIconName;
+        QString iconName;
+        QStringList globPatterns;
+    };
+
+    QByteArray mimeCache() const;
+    QByteArray mimeTypeXml(const QString &name, const MimeTypeData &data) const;
+
+    // Sorted by name, as the lists of mime.cache
+    QMap<QString, MimeTypeData> m_mimeTypes;
+    QMap<QByteArray, QByteArray> m_aliases;
+    QMap<QByteArray, QList<QByteArray> > m_parents;
+    QList<QMimeGlobPattern> m_globs;
+    QList<QMimeMagicRuleMatcher> m_magicMatchers;
+};
+
+QT_END_NAMESPACE
+
+#endif // QMIMECACHEWRITER_P_H
@@ -47,17 +47,26 @@
 
 #include "qmimeprovider_p.h"
 #include "qmimetype_p.h"
+#include <qstandardpaths.h>
 
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
 #include <QtCore/QFile>
 #include <QtCore/QFileInfo>
 #include <QtCore/QSet>
-#include <QtCore/QBuffer>
 #include <QtCore/QUrl>
-#include <QtCore/QStack>
 #include <QtCore/QDebug>
+#include <QtCore/QThread>
+#include <QtCore/QThreadStorage>
 
 #include <algorithm>
 #include <functional>
+#include <limits.h>
+
+#ifdef Q_OS_UNIX
+#include <errno.h>
+#endif
 
 QT_BEGIN_NAMESPACE
 
@@ -76,35 +85,279 @@ QMimeDatabasePrivate *QMimeDatabasePrivate::instance()
     return staticQMimeDatabase();
 }
 
+QMIME_EXPORT int qmime_secondsBetweenChecks = 5; // exported for the unit test
+
 QMimeDatabasePrivate::QMimeDatabasePrivate()
-    : m_provider(0), m_defaultMimeType(QLatin1String("application/octet-stream"))
+    : m_provider(0), m_lastCheck(0), m_providerType(UnknownProvider),
+      m_defaultMimeType(QLatin1String("application/octet-stream"))
 {
 }
 
 QMimeDatabasePrivate::~QMimeDatabasePrivate()
 {
-    delete m_provider;
+    QMimeProviderBase *current = m_provider;
+    if (current && !current->m_refCount.deref())
+        delete current;
     m_provider = 0;
 }
 
-QMimeProviderBase *QMimeDatabasePrivate::provider()
+/*!
+    \internal
+    Returns true if it is time to check whether the files of the database changed:
+    when the watcher saw a change in the mime directories or, if they cannot be
+    watched, every qmime_secondsBetweenChecks seconds.
+    Only one of the threads asking at the same time gets true.
+ */
+bool QMimeDatabasePrivate::shouldCheck()
+{
+    // The unit test sets the interval to 0 to check on each lookup, watcher or not
+    if (m_watcher.isWatching() && qmime_secondsBetweenChecks > 0)
+        return m_watcher.testAndClearChanged();
+
+    const int now = int(QDateTime::currentDateTimeUtc().toTime_t());
+    const int lastCheck = m_lastCheck;
+    if (lastCheck && now - lastCheck < qmime_secondsBetweenChecks)
+        return false;
+    return m_lastCheck.testAndSetOrdered(lastCheck, now);
+}
+
+QMIME_EXPORT int qmime_generatedCachesLoaded = 0; // exported for the unit test
+
+static const int maxGeneratedCaches = 4; // e.g. for processes with different XDG_DATA_DIRS
+
+static QString generatedCacheDir()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + QLatin1String("/qmime");
+}
+
+static QString generatedMimeDir(const QByteArray &packagesKey)
+{
+    return generatedCacheDir() + QString::fromLatin1("/mime-%1").arg(qHash(packagesKey), 8, 16, QLatin1Char('0'));
+}
+
+static void removeDirectory(const QString &path)
+{
+    QDir dir(path);
+    foreach (const QFileInfo &fileInfo, dir.entryInfoList(QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot)) {
+        if (fileInfo.isDir() && !fileInfo.isSymLink())
+            removeDirectory(fileInfo.filePath());
+        else
+            dir.remove(fileInfo.fileName());
+    }
+    QDir().rmdir(path);
+}
+
+/*!
+    \internal
+    Renames the freshly written \a tempDir to \a mimeDir. An existing \a mimeDir is
+    only replaced if \a replaceInvalid, i.e. it was there but not a valid cache,
+    e.g. left by an interrupted process: otherwise another process wrote it meanwhile.
+ */
+static bool renameGeneratedMimeDir(const QString &tempDir, const QString &mimeDir, bool replaceInvalid)
+{
+    if (QDir().rename(tempDir, mimeDir))
+        return true;
+    if (!replaceInvalid)
+        return false;
+    const QString oldDir = mimeDir + QString::fromLatin1(".old.%1").arg(QCoreApplication::applicationPid());
+    if (!QDir().rename(mimeDir, oldDir))
+        return false;
+    if (QFileInfo(oldDir).isDir())
+        removeDirectory(oldDir);
+    else
+        QFile::remove(oldDir);
+    return QDir().rename(tempDir, mimeDir);
+}
+
+/*!
+    \internal
+    Without any system mime.cache, the XML files are compiled into one in the
+    user's cache directory the first time they are loaded, and the next processes
+    map it with the binary provider rather than loading the XML files again.
+    Returns 0 if the binary provider cannot be used, or QT_NO_MIME_CACHE is set.
+ */
+QMimeProviderBase *QMimeDatabasePrivate::createGeneratedCacheProvider()
 {
-    if (!m_provider) {
+#if defined(QT_USE_MMAP)
+    if (!qgetenv("QT_NO_MIME_CACHE").isEmpty())
+        return 0;
+
+    const QStringList packageFiles = QMimeXMLProvider::packageFiles();
+    const QByteArray packagesKey = QMimeXMLProvider::packagesKey(packageFiles);
+    const QString mimeDir = generatedMimeDir(packagesKey);
+    QMimeBinaryProvider *cacheProvider = new QMimeGeneratedCacheProvider(this, mimeDir, packagesKey);
+    if (cacheProvider->isValid()) {
+        ++qmime_generatedCachesLoaded;
+        return cacheProvider;
+    }
+    delete cacheProvider;
+    const bool invalidMimeDirExists = QFileInfo(mimeDir).exists();
+
+    // This process uses what it parsed, the cache is for the next ones. It is written
+    // aside and renamed, so that other processes never see a partial directory.
+    // The cache replaces the XML snapshot, which isn't saved as well.
+    QMimeXMLProvider *xmlProvider = new QMimeXMLProvider(this);
+    xmlProvider->setSaveSnapshot(false);
+    xmlProvider->loadPackageFiles(packageFiles, packagesKey);
+    const QString tempDir = mimeDir + QString::fromLatin1(".%1").arg(QCoreApplication::applicationPid());
+    QString errorMessage;
+    removeDirectory(tempDir);
+    if (!xmlProvider->writeMimeCache(tempDir, &errorMessage)
+            || !QMimeGeneratedCacheProvider::writePackagesKey(tempDir, packagesKey, &errorMessage)) {
+        qWarning("QMimeDatabase: Cannot write the mime.cache of %s\n%s", qPrintable(mimeDir), qPrintable(errorMessage));
+        removeDirectory(tempDir);
+    } else if (!renameGeneratedMimeDir(tempDir, mimeDir, invalidMimeDirExists)) {
+        removeDirectory(tempDir); // written meanwhile by another process
+    } else {
+        QDir dir(generatedCacheDir());
+        const QStringList caches = dir.entryList(QStringList(QLatin1String("mime-????????")), QDir::Dirs, QDir::Time);
+        for (int i = maxGeneratedCaches; i < caches.count(); ++i)
+            removeDirectory(dir.filePath(caches.at(i)));
+    }
+    return xmlProvider;
+#else
+    return 0;
+#endif
+}
+
+/*!
+    \internal
+    Creates a fully loaded provider: the binary one if mime.cache files are
+    available the first time, the XML one otherwise, possibly through a generated
+    mime.cache. Later reloads keep the same kind of provider.
+ */
+QMimeProviderBase *QMimeDatabasePrivate::createProvider()
+{
+    QMimeProviderBase *newProvider = 0;
+    if (m_providerType != XMLProvider) {
         QMimeProviderBase *binaryProvider = new QMimeBinaryProvider(this);
-        if (binaryProvider->isValid()) {
-            m_provider = binaryProvider;
+        if (binaryProvider->isValid() || m_providerType == BinaryProvider) {
+            m_providerType = BinaryProvider;
+            newProvider = binaryProvider;
         } else {
             delete binaryProvider;
-            m_provider = new QMimeXMLProvider(this);
         }
     }
-    return m_provider;
+    if (!newProvider) {
+        m_providerType = XMLProvider;
+        newProvider = createGeneratedCacheProvider();
+    }
+    if (!newProvider)
+        newProvider = new QMimeXMLProvider(this);
+    newProvider->ensureLoaded();
+    return newProvider;
+}
+
+/*!
+    \internal
+    Publishes a new provider if there is none yet or if the files of the current
+    one changed. The lookups running meanwhile in other threads keep using the
+    previous provider, which is only deleted once they are done.
+ */
+void QMimeDatabasePrivate::refreshProvider()
+{
+    QMutexLocker locker(&mutex);
+    QMimeProviderBase *current = m_provider;
+    if (current && current->isUpToDate())
+        return;
+    if (!current) // watch before loading, so that no change goes unnoticed
+        m_watcher.watch(QStandardPaths::standardLocations(QStandardPaths::GenericDataLocation));
+    QMimeProviderBase *newProvider = createProvider();
+    m_provider.fetchAndStoreOrdered(newProvider);
+    if (current)
+        retireProvider(current);
+    else
+        m_lastCheck = int(QDateTime::currentDateTimeUtc().toTime_t()); // just loaded
 }
 
 void QMimeDatabasePrivate::setProvider(QMimeProviderBase *theProvider)
 {
-    delete m_provider;
-    m_provider = theProvider;
+    QMutexLocker locker(&mutex);
+    QMimeProviderBase *current = m_provider.fetchAndStoreOrdered(theProvider);
+    if (current)
+        retireProvider(current);
+}
+
+/*!
+    \internal
+    Called with the mutex locked, once \a oldProvider was replaced in m_provider:
+    drops the reference of the database to it. It is deleted right away if no
+    thread uses it, by its last QMimeProviderRef otherwise.
+ */
+void QMimeDatabasePrivate::retireProvider(QMimeProviderBase *oldProvider)
+{
+    // A thread which read m_provider before it was replaced may not have referenced
+    // the old provider yet: wait until no thread is in between, which is very short.
+    for (int i = 0; i < AcquiringCounterCount; ++i) {
+        while (m_acquiring[i].count != 0)
+            QThread::yieldCurrentThread();
+    }
+    if (!oldProvider->m_refCount.deref())
+        delete oldProvider;
+}
+
+struct QMimeProviderThreadData
+{
+    QMimeProviderThreadData(int counter) : provider(0), depth(0), acquiringCounter(counter) {}
+
+    QMimeProviderBase *provider; // referenced by the outermost QMimeProviderRef
+    int depth;                   // number of nested QMimeProviderRefs
+    const int acquiringCounter;
+};
+
+static QThreadStorage<QMimeProviderThreadData *> providerThreadData;
+static QAtomicInt nextAcquiringCounter;
+
+static inline QMimeProviderThreadData *localProviderThreadData()
+{
+    QMimeProviderThreadData *threadData = providerThreadData.localData();
+    if (!threadData) {
+        threadData = new QMimeProviderThreadData(nextAcquiringCounter.fetchAndAddRelaxed(1));
+        providerThreadData.setLocalData(threadData);
+    }
+    return threadData;
+}
+
+QMimeProviderBase *QMimeDatabasePrivate::provider() const
+{
+    QMimeProviderBase *threadProvider = localProviderThreadData()->provider;
+    Q_ASSERT(threadProvider); // only valid while a QMimeProviderRef is alive
+    return threadProvider;
+}
+
+/*!
+    \internal
+    Used by QMimeProviderRef: returns the current provider, reloaded first if needed,
+    and keeps it alive until the matching releaseProvider().
+    Only the provider itself is referenced, so a provider replaced meanwhile is
+    deleted as soon as the threads which were using it are done with it.
+ */
+QMimeProviderBase *QMimeDatabasePrivate::acquireProvider()
+{
+    QMimeProviderThreadData *threadData = localProviderThreadData();
+    if (threadData->depth++)
+        return threadData->provider;
+
+    if (!m_provider || shouldCheck())
+        refreshProvider();
+    QAtomicInt &acquiring = m_acquiring[threadData->acquiringCounter % AcquiringCounterCount].count;
+    acquiring.ref();
+    QMimeProviderBase *current = m_provider;
+    current->m_refCount.ref();
+    acquiring.deref();
+    threadData->provider = current;
+    return current;
+}
+
+void QMimeDatabasePrivate::releaseProvider()
+{
+    QMimeProviderThreadData *threadData = localProviderThreadData();
+    if (--threadData->depth)
+        return;
+    QMimeProviderBase *released = threadData->provider;
+    threadData->provider = 0;
+    if (!released->m_refCount.deref())
+        delete released; // replaced meanwhile, and this thread was the last one using it
 }
 
 /*!
@@ -117,25 +370,92 @@ QMimeType QMimeDatabasePrivate::mimeTypeForName(const QString &nameOrAlias)
 }
 
 QStringList QMimeDatabasePrivate::mimeTypeForFileName(const QString &fileName, QString *foundSuffix)
+{
+    QMimeGlobLookupContext context;
+    return mimeTypeForFileName(fileName, context, foundSuffix);
+}
+
+/*!
+    \internal
+    Same as above, reusing the buffers of \a context, e.g. across a batch of file names.
+ */
+QStringList QMimeDatabasePrivate::mimeTypeForFileName(const QString &fileName, QMimeGlobLookupContext &context, QString *foundSuffix)
 {
     if (fileName.endsWith(QLatin1Char('/')))
         return QStringList() << QLatin1String("inode/directory");
 
-    const QStringList matchingMimeTypes = provider()->findByFileName(QFileInfo(fileName).fileName(), foundSuffix);
+#if defined(Q_OS_WIN)
+    context.setFileName(QFileInfo(fileName).fileName());
+#else
+    // Same as QFileInfo(fileName).fileName(), without allocating a QFileInfo and a copy
+    const int lastSlash = fileName.lastIndexOf(QLatin1Char('/'));
+    if (lastSlash == -1)
+        context.setFileName(fileName);
+    else
+        context.setFileName(QString::fromRawData(fileName.unicode() + lastSlash + 1, fileName.length() - lastSlash - 1));
+#endif
+    const QStringList matchingMimeTypes = provider()->findByFileName(context, foundSuffix);
     return matchingMimeTypes;
 }
 
-static inline bool isTextFile(const QByteArray &data)
+/*!
+    \internal
+    Returns the MIME type for the glob \a matches of a file name, i.e. for MatchExtension.
+ */
+QMimeType QMimeDatabasePrivate::mimeTypeForFileExtension(QStringList matches)
+{
+    const int matchCount = matches.count();
+    if (matchCount == 0) {
+        return mimeTypeForName(defaultMimeType());
+    } else if (matchCount == 1) {
+        return mimeTypeForName(matches.first());
+    } else {
+        // We have to pick one.
+        matches.sort(); // Make it deterministic
+        return mimeTypeForName(matches.first());
+    }
+}
+
+/*!
+    \internal
+    The lookup context and the MIME types found are reused across the whole batch.
+ */
+QVector<QMimeType> QMimeDatabasePrivate::mimeTypesForFileNames(const QStringList &fileNames)
+{
+    QVector<QMimeType> result;
+    result.reserve(fileNames.size());
+
+    QMimeGlobLookupContext context;
+    QHash<QString, QMimeType> mimeTypes; // by the first glob match, in this batch
+    for (int i = 0; i < fileNames.size(); ++i) {
+        const QStringList matches = mimeTypeForFileName(fileNames.at(i), context);
+        const QString name = matches.isEmpty() ? QString() : matches.first();
+        QHash<QString, QMimeType>::const_iterator it = mimeTypes.constFind(name);
+        if (matches.count() <= 1 && it != mimeTypes.constEnd()) {
+            result.append(it.value());
+        } else {
+            const QMimeType mime = mimeTypeForFileExtension(matches);
+            if (matches.count() <= 1)
+                mimeTypes.insert(name, mime);
+            result.append(mime);
+        }
+    }
+    return result;
+}
+
+static inline bool isTextFile(const char *data, int dataSize)
 {
     // UTF16 byte order marks
-    static const char bigEndianBOM[] = "\xFE\xFF";
-    static const char littleEndianBOM[] = "\xFF\xFE";
-    if (data.startsWith(bigEndianBOM) || data.startsWith(littleEndianBOM))
-        return true;
+    if (dataSize >= 2) {
+        const uchar bom0 = data[0];
+        const uchar bom1 = data[1];
+        if ((bom0 == 0xFE && bom1 == 0xFF) || (bom0 == 0xFF && bom1 == 0xFE))
+            return true;
+    }
 
     // Check the first 32 bytes (see shared-mime spec)
-    const char *p = data.constData();
-    const char *e = p + qMin(32, data.size());
+    const char *p = data;
+    const char *e = p + qMin(32, dataSize);
     for ( ; p < e; ++p) {
         if ((unsigned char)(*p) < 32 && *p != 9 && *p !=10 && *p != 13)
             return false;
@@ -144,20 +464,20 @@ static inline bool isTextFile(const QByteArray &data)
     return true;
 }
 
-QMimeType QMimeDatabasePrivate::findByData(const QByteArray &data, int *accuracyPtr)
+QMimeType QMimeDatabasePrivate::findByData(const char *data, int dataSize, int *accuracyPtr)
 {
-    if (data.isEmpty()) {
+    if (dataSize <= 0) {
         *accuracyPtr = 100;
         return mimeTypeForName(QLatin1String("application/x-zerosize"));
     }
 
     *accuracyPtr = 0;
-    QMimeType candidate = provider()->findByMagic(data, accuracyPtr);
+    QMimeType candidate = provider()->findByMagic(data, dataSize, accuracyPtr);
 
     if (candidate.isValid())
         return candidate;
 
-    if (isTextFile(data)) {
+    if (isTextFile(data, dataSize)) {
         *accuracyPtr = 5;
         return mimeTypeForName(QLatin1String("text/plain"));
     }
@@ -165,7 +485,107 @@ QMimeType QMimeDatabasePrivate::findByData(const QByteArray &data, int *accuracy
     return mimeTypeForName(defaultMimeType());
 }
 
-QMimeType QMimeDatabasePrivate::mimeTypeForFileNameAndData(const QString &fileName, QIODevice *device, int *accuracyPtr)
+/*!
+    \internal
+    Exported for the unit test: the magic lookup of findByData(), with or without
+    the dispatch index, returning the number of magic matchers of the provider in
+    \a matcherCount, how many of them it tried in \a matchersEvaluated and the
+    number of magic rules it evaluated in \a rulesEvaluated.
+    Returns an empty string if no magic rule matches.
+ */
+QMIME_EXPORT QString qmime_mimeTypeForMagic(const QByteArray &data, bool useDispatchIndex,
+                                            int *matcherCount, int *matchersEvaluated, int *rulesEvaluated)
+{
+    QMimeProviderRef provider(QMimeDatabasePrivate::instance());
+    QMimeMagicLookupStats stats;
+    stats.useDispatchIndex = useDispatchIndex;
+    int accuracy = 0;
+    const QMimeType mime = provider->findByMagic(data.constData(), data.size(), &accuracy, &stats);
+    *matcherCount = stats.matcherCount;
+    *matchersEvaluated = stats.matchersEvaluated;
+    *rulesEvaluated = stats.rulesEvaluated;
+    return mime.name();
+}
+
+/*!
+    \internal
+    Returns the number of bytes to read from a device to determine its MIME type:
+    the furthest any magic rule can look, but at least what isTextFile() looks at.
+ */
+int QMimeDatabasePrivate::magicReadSize()
+{
+    // Never more than 16K (QIODEVICE_BUFFERSIZE in qiodevice_p.h), as before.
+    return qBound(32, provider()->magicMaxExtent(), 16384);
+}
+
+/*!
+    \internal
+    \class QMimeDataReader
+
+    Reads the beginning of the data whose MIME type is determined, only when the
+    file name is not enough.
+ */
+
+bool QMimeDeviceReader::read(int maxSize, const char **data, int *dataSize)
+{
+    if (!m_device->isOpen())
+        return false;
+    // Read all the needed data in one go.
+    // This is much faster than seeking back and forth into QIODevice.
+    m_data = m_device->peek(maxSize);
+    *data = m_data.constData();
+    *dataSize = m_data.size();
+    return true;
+}
+
+bool QMimeBufferReader::read(int maxSize, const char **data, int *dataSize)
+{
+    *data = m_data;
+    *dataSize = qMin(maxSize, m_dataSize);
+    return true;
+}
+
+#ifdef Q_OS_UNIX
+// Reused by all the lookups of a thread, so sniffing a file does not allocate
+static QThreadStorage<QByteArray *> localFileReadBuffer;
+
+/*!
+    \internal
+    \class QMimeLocalFileReader
+
+    Reads the beginning of a local regular file with a single pread() into a thread-local
+    buffer, instead of going through QFile and the QIODevice buffer.
+ */
+
+bool QMimeLocalFileReader::read(int maxSize, const char **data, int *dataSize)
+{
+    const int fd = QT_OPEN(m_nativeFilePath.constData(), QT_OPEN_RDONLY);
+    if (fd == -1)
+        return false;
+
+    if (!localFileReadBuffer.hasLocalData())
+        localFileReadBuffer.setLocalData(new QByteArray);
+    QByteArray *buffer = localFileReadBuffer.localData();
+    if (buffer->size() < maxSize)
+        buffer->resize(maxSize);
+
+    int bytesRead = 0;
+    while (bytesRead < maxSize) {
+        const qint64 n = ::pread(fd, buffer->data() + bytesRead, maxSize - bytesRead, bytesRead);
+        if (n > 0)
+            bytesRead += n;
+        else if (n == 0 || errno != EINTR)
+            break;
+    }
+    QT_CLOSE(fd);
+
+    *data = buffer->constData();
+    *dataSize = bytesRead;
+    return true;
+}
+#endif
+
+QMimeType QMimeDatabasePrivate::mimeTypeForFileNameAndData(const QString &fileName, QMimeDataReader &reader, int *accuracyPtr)
 {
     // First, glob patterns are evaluated. If there is a match with max weight,
     // this one is selected and we are done. Otherwise, the file contents are
@@ -186,14 +606,11 @@ QMimeType QMimeDatabasePrivate::mimeTypeForFileNameAndData(const QString &fileNa
 
     // Extension is unknown, or matches multiple mimetypes.
     // Pass 2) Match on content, if we can read the data
-    if (device->isOpen()) {
-
-        // Read 16K in one go (QIODEVICE_BUFFERSIZE in qiodevice_p.h).
-        // This is much faster than seeking back and forth into QIODevice.
-        const QByteArray data = device->peek(16384);
-
+    const char *data;
+    int dataSize;
+    if (reader.read(magicReadSize(), &data, &dataSize)) {
         int magicAccuracy = 0;
-        QMimeType candidateByData(findByData(data, &magicAccuracy));
+        QMimeType candidateByData(findByData(data, dataSize, &magicAccuracy));
 
         // Disambiguate conflicting extensions (if magic matching found something)
         if (candidateByData.isValid() && magicAccuracy > 0) {
@@ -230,18 +647,8 @@ QList<QMimeType> QMimeDatabasePrivate::allMimeTypes()
 
 bool QMimeDatabasePrivate::inherits(const QString &mime, const QString &parent)
 {
-    const QString resolvedParent = provider()->resolveAlias(parent);
     //Q_ASSERT(provider()->resolveAlias(mime) == mime);
-    QStack<QString> toCheck;
-    toCheck.push(mime);
-    while (!toCheck.isEmpty()) {
-        const QString current = toCheck.pop();
-        if (current == resolvedParent)
-            return true;
-        foreach (const QString &par, provider()->parents(current))
-            toCheck.push(par);
-    }
-    return false;
+    return provider()->inherits(mime, parent);
 }
 
 /*!
@@ -321,7 +728,7 @@ QMimeDatabase::~QMimeDatabase()
  */
 QMimeType QMimeDatabase::mimeTypeForName(const QString &nameOrAlias) const
 {
-    QMutexLocker locker(&d->mutex);
+    QMimeProviderRef provider(d);
 
     return d->mimeTypeForName(nameOrAlias);
 }
@@ -358,18 +765,30 @@ QMimeType QMimeDatabase::mimeTypeForFile(const QFileInfo &fileInfo, MatchMode mo
 {
     DBG() << "fileInfo" << fileInfo.absoluteFilePath();
 
-    QMutexLocker locker(&d->mutex);
+    QMimeProviderRef provider(d);
 
     if (fileInfo.isDir())
         return d->mimeTypeForName(QLatin1String("inode/directory"));
 
     QFile file(fileInfo.absoluteFilePath());
+    int priority = 0;
 
 #ifdef Q_OS_UNIX
     // Cannot access statBuf.st_mode from the filesystem engine, so we have to stat again.
     const QByteArray nativeFilePath = QFile::encodeName(file.fileName());
     QT_STATBUF statBuffer;
     if (QT_LSTAT(nativeFilePath.constData(), &statBuffer) == 0) {
+        if (S_ISREG(statBuffer.st_mode) && mode != MatchExtension) {
+            QMimeLocalFileReader reader(nativeFilePath);
+            if (mode == MatchContent) {
+                const char *data;
+                int dataSize;
+                if (!reader.read(d->magicReadSize(), &data, &dataSize))
+                    return d->mimeTypeForName(d->defaultMimeType());
+                return d->findByData(data, dataSize, &priority);
+            }
+            return d->mimeTypeForFileNameAndData(fileInfo.absoluteFilePath(), reader, &priority);
+        }
         if (S_ISCHR(statBuffer.st_mode))
             return d->mimeTypeForName(QLatin1String("inode/chardevice"));
         if (S_ISBLK(statBuffer.st_mode))
@@ -381,17 +800,16 @@ QMimeType QMimeDatabase::mimeTypeForFile(const QFileInfo &fileInfo, MatchMode mo
     }
 #endif
 
-    int priority = 0;
     switch (mode) {
-    case MatchDefault:
-        file.open(QIODevice::ReadOnly); // isOpen() will be tested by method below
-        return d->mimeTypeForFileNameAndData(fileInfo.absoluteFilePath(), &file, &priority);
+    case MatchDefault: {
+        file.open(QIODevice::ReadOnly); // isOpen() will be tested by the reader
+        QMimeDeviceReader reader(&file);
+        return d->mimeTypeForFileNameAndData(fileInfo.absoluteFilePath(), reader, &priority);
+    }
     case MatchExtension:
-        locker.unlock();
         return mimeTypeForFile(fileInfo.absoluteFilePath(), mode);
     case MatchContent:
         if (file.open(QIODevice::ReadOnly)) {
-            locker.unlock();
             return mimeTypeForData(&file);
         } else {
             return d->mimeTypeForName(d->defaultMimeType());
@@ -410,25 +828,34 @@ QMimeType QMimeDatabase::mimeTypeForFile(const QFileInfo &fileInfo, MatchMode mo
 QMimeType QMimeDatabase::mimeTypeForFile(const QString &fileName, MatchMode mode) const
 {
     if (mode == MatchExtension) {
-        QMutexLocker locker(&d->mutex);
-        QStringList matches = d->mimeTypeForFileName(fileName);
-        const int matchCount = matches.count();
-        if (matchCount == 0) {
-            return d->mimeTypeForName(d->defaultMimeType());
-        } else if (matchCount == 1) {
-            return d->mimeTypeForName(matches.first());
-        } else {
-            // We have to pick one.
-            matches.sort(); // Make it deterministic
-            return d->mimeTypeForName(matches.first());
-        }
+        QMimeProviderRef provider(d);
+        return d->mimeTypeForFileExtension(d->mimeTypeForFileName(fileName));
     } else {
-        // Implemented as a wrapper around mimeTypeForFile(QFileInfo), so no mutex.
+        // Implemented as a wrapper around mimeTypeForFile(QFileInfo)
         QFileInfo fileInfo(fileName);
         return mimeTypeForFile(fileInfo);
     }
 }
 
+/*!
+    Returns the MIME type for each of the file names in \a fileNames, in the same order.
+
+    Each MIME type is the same as what mimeTypeForFile(fileName, MatchExtension)
+    returns, but the database is checked for changes on disk only once for the
+    whole list. This is much faster when classifying many file names, e.g.
+    the entries of a directory listing.
+
+    The files are not opened.
+
+    \sa mimeTypeForFile
+*/
+QVector<QMimeType> QMimeDatabase::mimeTypesForFileNames(const QStringList &fileNames) const
+{
+    QMimeProviderRef provider(d);
+
+    return d->mimeTypesForFileNames(fileNames);
+}
+
 /*!
     \fn QList<QMimeType> QMimeDatabase::mimeTypesForFileName(const QString &fileName) const;
     Returns the MIME types for the file name \a fileName.
@@ -444,7 +871,7 @@ QMimeType QMimeDatabase::mimeTypeForFile(const QString &fileName, MatchMode mode
 */
 QList<QMimeType> QMimeDatabase::mimeTypesForFileName(const QString &fileName) const
 {
-    QMutexLocker locker(&d->mutex);
+    QMimeProviderRef provider(d);
 
     QStringList matches = d->mimeTypeForFileName(fileName);
     QList<QMimeType> mimes;
@@ -461,7 +888,7 @@ QList<QMimeType> QMimeDatabase::mimeTypesForFileName(const QString &fileName) co
 */
 QString QMimeDatabase::suffixForFileName(const QString &fileName) const
 {
-    QMutexLocker locker(&d->mutex);
+    QMimeProviderRef provider(d);
     QString foundSuffix;
     d->mimeTypeForFileName(fileName, &foundSuffix);
     return foundSuffix;
@@ -476,10 +903,29 @@ QString QMimeDatabase::suffixForFileName(const QString &fileName) const
 */
 QMimeType QMimeDatabase::mimeTypeForData(const QByteArray &data) const
 {
-    QMutexLocker locker(&d->mutex);
+    QMimeProviderRef provider(d);
 
     int accuracy = 0;
-    return d->findByData(data, &accuracy);
+    return d->findByData(data.constData(), data.size(), &accuracy);
+}
+
+/*!
+    Returns a MIME type for the \a size bytes at \a data.
+
+    This overload allows to determine the MIME type of data which isn't
+    held by a QByteArray, e.g. a network receive buffer or a memory-mapped
+    file, without copying it.
+
+    A valid MIME type is always returned. If \a data doesn't match any
+    known MIME type data, the default MIME type (application/octet-stream)
+    is returned.
+*/
+QMimeType QMimeDatabase::mimeTypeForData(const char *data, qint64 size) const
+{
+    QMimeProviderRef provider(d);
+
+    int accuracy = 0;
+    return d->findByData(data, int(qBound(Q_INT64_C(0), size, qint64(INT_MAX))), &accuracy);
 }
 
 /*!
@@ -491,15 +937,15 @@ QMimeType QMimeDatabase::mimeTypeForData(const QByteArray &data) const
 */
 QMimeType QMimeDatabase::mimeTypeForData(QIODevice *device) const
 {
-    QMutexLocker locker(&d->mutex);
+    QMimeProviderRef provider(d);
 
     int accuracy = 0;
     const bool openedByUs = !device->isOpen() && device->open(QIODevice::ReadOnly);
     if (device->isOpen()) {
-        // Read 16K in one go (QIODEVICE_BUFFERSIZE in qiodevice_p.h).
+        // Read all the needed data in one go.
         // This is much faster than seeking back and forth into QIODevice.
-        const QByteArray data = device->peek(16384);
-        const QMimeType result = d->findByData(data, &accuracy);
+        const QByteArray data = device->peek(d->magicReadSize());
+        const QMimeType result = d->findByData(data.constData(), data.size(), &accuracy);
         if (openedByUs)
             device->close();
         return result;
@@ -557,9 +1003,12 @@ QMimeType QMimeDatabase::mimeTypeForFileNameAndData(const QString &fileName, QIO
 {
     DBG() << "fileName" << fileName;
 
+    QMimeProviderRef provider(d);
+
     int accuracy = 0;
     const bool openedByUs = !device->isOpen() && device->open(QIODevice::ReadOnly);
-    const QMimeType result = d->mimeTypeForFileNameAndData(fileName, device, &accuracy);
+    QMimeDeviceReader reader(device);
+    const QMimeType result = d->mimeTypeForFileNameAndData(fileName, reader, &accuracy);
     if (openedByUs)
         device->close();
     return result;
@@ -585,10 +1034,11 @@ QMimeType QMimeDatabase::mimeTypeForFileNameAndData(const QString &fileName, con
 {
     DBG() << "fileName" << fileName;
 
-    QBuffer buffer(const_cast<QByteArray *>(&data));
-    buffer.open(QIODevice::ReadOnly);
+    QMimeProviderRef provider(d);
+
+    QMimeBufferReader reader(data.constData(), data.size());
     int accuracy = 0;
-    return d->mimeTypeForFileNameAndData(fileName, &buffer, &accuracy);
+    return d->mimeTypeForFileNameAndData(fileName, reader, &accuracy);
 }
 
 /*!
@@ -600,7 +1050,7 @@ QMimeType QMimeDatabase::mimeTypeForFileNameAndData(const QString &fileName, con
 */
 QList<QMimeType> QMimeDatabase::allMimeTypes() const
 {
-    QMutexLocker locker(&d->mutex);
+    QMimeProviderRef provider(d);
 
     return d->allMimeTypes();
 }
@@ -47,6 +47,7 @@
 #include "qmimetype.h"
 
 #include <QtCore/qstringlist.h>
+#include <QtCore/qvector.h>
 
 #if (QT_VERSION >= QT_VERSION_CHECK(5, 0, 0))
 #error "Do not try to use this library with Qt5, use QtCore/QMimeType instead"
@@ -79,9 +80,11 @@ public:
     QMimeType mimeTypeForFile(const QString &fileName, MatchMode mode = MatchDefault) const;
     QMimeType mimeTypeForFile(const QFileInfo &fileInfo, MatchMode mode = MatchDefault) const;
     QList<QMimeType> mimeTypesForFileName(const QString &fileName) const;
+    QVector<QMimeType> mimeTypesForFileNames(const QStringList &fileNames) const;
 
     QMimeType mimeTypeForData(const QByteArray &data) const;
     QMimeType mimeTypeForData(QIODevice *device) const;
+    QMimeType mimeTypeForData(const char *data, qint64 size) const;
 
     QMimeType mimeTypeForUrl(const QUrl &url) const;
     QMimeType mimeTypeForFileNameAndData(const QString &fileName, QIODevice *device) const;
@@ -90,6 +93,7 @@ public:
     QList<QMimeType> allMimeTypes() const;
 
 private:
+    friend class QMimeDataSniffer;
     QMimeDatabasePrivate *d;
 };
 
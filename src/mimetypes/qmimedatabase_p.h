@@ -42,17 +42,64 @@
 #ifndef QMIMEDATABASE_P_H
 #define QMIMEDATABASE_P_H
 
+#include <QtCore/qatomic.h>
 #include <QtCore/qhash.h>
+#include <QtCore/qlist.h>
 #include <QtCore/qmutex.h>
 
 #include "qmimetype.h"
 #include "qmimetype_p.h"
 #include "qmimeglobpattern_p.h"
+#include "qmimewatcher_p.h"
 
 QT_BEGIN_NAMESPACE
 
 class QMimeDatabase;
 class QMimeProviderBase;
+class QIODevice;
+
+class QMimeDataReader
+{
+public:
+    virtual ~QMimeDataReader() {}
+
+    // Returns false if the data cannot be read
+    virtual bool read(int maxSize, const char **data, int *dataSize) = 0;
+};
+
+class QMimeDeviceReader : public QMimeDataReader
+{
+public:
+    explicit QMimeDeviceReader(QIODevice *device) : m_device(device) {}
+    virtual bool read(int maxSize, const char **data, int *dataSize);
+
+private:
+    QIODevice *m_device;
+    QByteArray m_data;
+};
+
+class QMimeBufferReader : public QMimeDataReader
+{
+public:
+    QMimeBufferReader(const char *data, int dataSize) : m_data(data), m_dataSize(dataSize) {}
+    virtual bool read(int maxSize, const char **data, int *dataSize);
+
+private:
+    const char *m_data;
+    int m_dataSize;
+};
+
+#ifdef Q_OS_UNIX
+class QMimeLocalFileReader : public QMimeDataReader
+{
+public:
+    explicit QMimeLocalFileReader(const QByteArray &nativeFilePath) : m_nativeFilePath(nativeFilePath) {}
+    virtual bool read(int maxSize, const char **data, int *dataSize);
+
+private:
+    const QByteArray m_nativeFilePath;
+};
+#endif
 
 class QMimeDatabasePrivate
 {
@@ -64,8 +111,11 @@ public:
 
     static QMimeDatabasePrivate *instance();
 
-    QMimeProviderBase *provider();
+    // The provider of the QMimeProviderRef alive in the calling thread
+    QMimeProviderBase *provider() const;
     void setProvider(QMimeProviderBase *theProvider);
+    QMimeProviderBase *acquireProvider();
+    void releaseProvider();
 
     inline QString defaultMimeType() const { return m_defaultMimeType; }
 
@@ -75,13 +125,66 @@ public:
 
 
     QMimeType mimeTypeForName(const QString &nameOrAlias);
-    QMimeType mimeTypeForFileNameAndData(const QString &fileName, QIODevice *device, int *priorityPtr);
-    QMimeType findByData(const QByteArray &data, int *priorityPtr);
+    QMimeType mimeTypeForFileNameAndData(const QString &fileName, QMimeDataReader &reader, int *priorityPtr);
+    QMimeType findByData(const char *data, int dataSize, int *priorityPtr);
+    int magicReadSize();
     QStringList mimeTypeForFileName(const QString &fileName, QString *foundSuffix = 0);
+    QStringList mimeTypeForFileName(const QString &fileName, QMimeGlobLookupContext &context, QString *foundSuffix = 0);
+    QMimeType mimeTypeForFileExtension(QStringList matches);
+    QVector<QMimeType> mimeTypesForFileNames(const QStringList &fileNames);
+
+private:
+    enum ProviderType { UnknownProvider, BinaryProvider, XMLProvider };
+
+    bool shouldCheck();
+    void refreshProvider();
+    QMimeProviderBase *createProvider();
+    QMimeProviderBase *createGeneratedCacheProvider();
+    void retireProvider(QMimeProviderBase *oldProvider);
+
+    // The providers are immutable snapshots of the database: they are fully loaded
+    // before being published here, and replaced as a whole when the files change.
+    QAtomicPointer<QMimeProviderBase> m_provider;
+    QAtomicInt m_lastCheck; // time_t of the last check for changes
+    QMimeDirectoryWatcher m_watcher; // when available, replaces the periodic checks
+    ProviderType m_providerType;
+
+    // Number of threads between reading m_provider and referencing it, spread
+    // over a few cache lines: a provider is only released once they are done.
+    enum { AcquiringCounterCount = 16 };
+    struct AcquiringCounter
+    {
+        QAtomicInt count;
+        char padding[64 - sizeof(QAtomicInt)];
+    };
+    AcquiringCounter m_acquiring[AcquiringCounterCount];
 
-    mutable QMimeProviderBase *m_provider;
+public:
     const QString m_defaultMimeType;
-    QMutex mutex;
+    QMutex mutex; // serializes the reloads of the provider, never held by lookups
+};
+
+/*
+   Gives access to the current provider for the lifetime of this object, without
+   locking. The provider is first reloaded if the files it was built from changed;
+   a provider replaced meanwhile by another thread stays alive until the last
+   QMimeProviderRef using it is gone. Nested QMimeProviderRefs in the same thread
+   use the same provider.
+ */
+class QMimeProviderRef
+{
+public:
+    explicit QMimeProviderRef(QMimeDatabasePrivate *db)
+        : m_db(db), m_provider(db->acquireProvider())
+    {}
+    ~QMimeProviderRef() { m_db->releaseProvider(); }
+
+    inline QMimeProviderBase *operator->() const { return m_provider; }
+
+private:
+    Q_DISABLE_COPY(QMimeProviderRef)
+    QMimeDatabasePrivate *m_db;
+    QMimeProviderBase *m_provider;
 };
 
 QT_END_NAMESPACE
@@ -0,0 +1,235 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtCore module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qmimedatasniffer.h"
+
+#include "qmimedatabase.h"
+#include "qmimedatabase_p.h"
+#include "qmimeprovider_p.h"
+
+QT_BEGIN_NAMESPACE
+
+class QMimeDataSnifferPrivate
+{
+public:
+    explicit QMimeDataSnifferPrivate(QMimeDatabasePrivate *database)
+        : db(database), status(QMimeDataSniffer::NeedMoreData), bytesNeeded(0), bytesReceived(0)
+    {}
+
+    void update();
+
+    QMimeDatabasePrivate *db;
+    QByteArray buffer;
+    QMimeType mimeType;
+    QMimeDataSniffer::Status status;
+    int bytesNeeded;
+    qint64 bytesReceived;
+};
+
+/*!
+    \internal
+    Re-runs the magic over the buffered data and asks the provider how many bytes
+    are needed before that result can no longer change.
+*/
+void QMimeDataSnifferPrivate::update()
+{
+    QMimeProviderRef provider(db);
+
+    const int readSize = db->magicReadSize();
+    int accuracy = 0;
+    mimeType = db->findByData(buffer.constData(), buffer.size(), &accuracy);
+
+    int needed = provider->magicDataNeeded(buffer.constData(), buffer.size());
+    // The text/binary guess and the zero-size type depend on the first 32 bytes
+    if (buffer.isEmpty() || accuracy <= 5)
+        needed = qMax(needed, 32);
+    needed = qMin(needed, readSize);
+
+    if (buffer.size() >= needed) {
+        status = QMimeDataSniffer::Decided;
+        bytesNeeded = 0;
+    } else {
+        status = QMimeDataSniffer::NeedMoreData;
+        bytesNeeded = needed - buffer.size();
+    }
+}
+
+/*!
+    \class QMimeDataSniffer
+    \brief The QMimeDataSniffer class determines the MIME type of data which arrives in chunks.
+
+    When data is received incrementally, e.g. over the network, it is not known in
+    advance how many bytes mimeTypeForData() needs to look at. QMimeDataSniffer accepts
+    the data chunk by chunk and tells after each chunk whether the MIME type is already
+    final (Decided), or how many more bytes are needed (bytesNeeded()) to resolve the
+    magic rules which could still change the result.
+
+    The decision is based on the offsets and priorities of the magic rules: once
+    status() is Decided, mimeType() is the same as what
+    QMimeDatabase::mimeTypeForData() returns for any longer prefix of the data.
+    Further data passed to addData() is then ignored.
+
+    If the data ends before a decision could be made, call finish() to get the
+    MIME type of the data received so far.
+
+    \code
+    QMimeDatabase db;
+    QMimeDataSniffer sniffer(db);
+    while (sniffer.addData(socket->readAll()) == QMimeDataSniffer::NeedMoreData) {
+        if (!socket->waitForReadyRead())
+            break;
+    }
+    sniffer.finish();
+    QMimeType mime = sniffer.mimeType();
+    \endcode
+
+    \sa QMimeDatabase::mimeTypeForData()
+ */
+
+/*!
+    \enum QMimeDataSniffer::Status
+
+    \value NeedMoreData The MIME type may still change with more data, see bytesNeeded().
+    \value Decided The MIME type is final, more data would not change it.
+    \value Finished finish() was called, the MIME type is that of the data received.
+ */
+
+/*!
+    Constructs a sniffer which uses the MIME types known to \a database.
+ */
+QMimeDataSniffer::QMimeDataSniffer(const QMimeDatabase &database)
+    : d(new QMimeDataSnifferPrivate(database.d))
+{
+    d->update();
+}
+
+/*!
+    Destroys the sniffer.
+ */
+QMimeDataSniffer::~QMimeDataSniffer()
+{
+    delete d;
+    d = 0;
+}
+
+/*!
+    Appends the \a size bytes at \a data to the data seen so far and returns the new status.
+ */
+QMimeDataSniffer::Status QMimeDataSniffer::addData(const char *data, qint64 size)
+{
+    if (d->status != NeedMoreData || size <= 0)
+        return d->status;
+
+    d->bytesReceived += size;
+    // Only what the magic rules can look at needs to be kept
+    const qint64 take = qMin(size, qint64(d->bytesNeeded));
+    d->buffer.append(data, int(take));
+    d->update();
+    return d->status;
+}
+
+/*!
+    \overload
+ */
+QMimeDataSniffer::Status QMimeDataSniffer::addData(const QByteArray &data)
+{
+    return addData(data.constData(), data.size());
+}
+
+/*!
+    Marks the end of the data and returns Finished, unless the MIME type was already
+    Decided. mimeType() is then that of the data received so far.
+ */
+QMimeDataSniffer::Status QMimeDataSniffer::finish()
+{
+    if (d->status == NeedMoreData) {
+        d->status = Finished;
+        d->bytesNeeded = 0;
+    }
+    return d->status;
+}
+
+/*!
+    Returns the current status.
+ */
+QMimeDataSniffer::Status QMimeDataSniffer::status() const
+{
+    return d->status;
+}
+
+/*!
+    Returns how many more bytes are needed, at most, before the MIME type is decided.
+    Returns 0 once status() is no longer NeedMoreData.
+ */
+qint64 QMimeDataSniffer::bytesNeeded() const
+{
+    return d->bytesNeeded;
+}
+
+/*!
+    Returns the number of bytes passed to addData() up to the decision.
+ */
+qint64 QMimeDataSniffer::bytesReceived() const
+{
+    return d->bytesReceived;
+}
+
+/*!
+    Returns the MIME type of the data received so far.
+
+    This is only a guess while status() is NeedMoreData.
+ */
+QMimeType QMimeDataSniffer::mimeType() const
+{
+    return d->mimeType;
+}
+
+/*!
+    Forgets all data received so far, so that the sniffer can be reused for another stream.
+ */
+void QMimeDataSniffer::reset()
+{
+    d->buffer.clear();
+    d->bytesReceived = 0;
+    d->update();
+}
+
+QT_END_NAMESPACE
@@ -41,7 +41,6 @@
 
 #include "qmimeglobpattern_p.h"
 
-#include <QRegExp>
 #include <QStringList>
 #include <QDebug>
 
@@ -81,6 +80,29 @@ void QMimeGlobMatchResult::addMatch(const QString &mimeType, int weight, const Q
         m_foundSuffix = pattern.mid(2);
 }
 
+/*!
+    \internal
+    Sets the file name to look up next. The lowercase buffer is reused, so that a
+    context which is kept across many lookups doesn't allocate for each of them.
+*/
+void QMimeGlobLookupContext::setFileName(const QString &fileName)
+{
+    m_fileName = fileName;
+    const int len = fileName.length();
+    m_lowerFileName.resize(len);
+    const QChar *src = fileName.unicode();
+    QChar *dst = m_lowerFileName.data();
+    for (int i = 0; i < len; ++i) {
+        if (src[i].isHighSurrogate() && i + 1 < len && src[i + 1].isLowSurrogate()) {
+            const uint lower = QChar::toLower(QChar::surrogateToUcs4(src[i], src[i + 1]));
+            dst[i] = QChar(QChar::highSurrogate(lower));
+            dst[++i] = QChar(QChar::lowSurrogate(lower));
+        } else {
+            dst[i] = src[i].toLower();
+        }
+    }
+}
+
 /*!
     \internal
     \class QMimeGlobPattern
@@ -89,65 +111,334 @@ void QMimeGlobMatchResult::addMatch(const QString &mimeType, int weight, const Q
     \sa QMimeType, QMimeDatabase, QMimeMagicRuleMatcher, QMimeMagicRule
 */
 
-bool QMimeGlobPattern::matchFileName(const QString &inputFilename) const
+/*!
+    \internal
+    Classifies the pattern once, so that matchFileName() neither parses the pattern
+    nor allocates memory. Patterns with a single run of fixed characters and '*'
+    at either or both ends are matched with a plain comparison, everything else
+    is compiled into a list of wildcard tokens.
+*/
+void QMimeGlobPattern::compile()
+{
+    const int len = m_pattern.length();
+    const QChar *p = m_pattern.unicode();
+
+    int starCount = 0;
+    bool hasOtherSpecials = false;
+    for (int i = 0; i < len; ++i) {
+        const QChar c = p[i];
+        if (c == QLatin1Char('*'))
+            ++starCount;
+        else if (c == QLatin1Char('?') || c == QLatin1Char('[') || c == QLatin1Char('\\'))
+            hasOtherSpecials = true;
+    }
+
+    if (!hasOtherSpecials) {
+        const bool leadingStar = len > 0 && p[0] == QLatin1Char('*');
+        const bool trailingStar = len > 1 && p[len - 1] == QLatin1Char('*');
+        if (starCount == 0) {
+            m_patternType = LiteralPattern;
+            m_literal = m_pattern;
+            return;
+        }
+        if (starCount == 1 && leadingStar) {
+            m_patternType = SuffixPattern;
+            m_literal = m_pattern.mid(1);
+            return;
+        }
+        if (starCount == 1 && trailingStar) {
+            m_patternType = PrefixPattern;
+            m_literal = m_pattern.left(len - 1);
+            return;
+        }
+        if (starCount == 2 && leadingStar && trailingStar) {
+            m_patternType = ContainsPattern;
+            m_literal = m_pattern.mid(1, len - 2);
+            return;
+        }
+    }
+
+    // Same syntax as QRegExp::WildcardUnix, which was used here before
+    m_patternType = WildcardPattern;
+    for (int i = 0; i < len; ++i) {
+        WildcardToken token;
+        token.kind = WildcardToken::Char;
+        token.ch = p[i].unicode();
+        token.firstRange = 0;
+        token.rangeCount = 0;
+
+        if (p[i] == QLatin1Char('*')) {
+            token.kind = WildcardToken::AnyString;
+            // "**" is the same as "*"
+            if (!m_tokens.isEmpty() && m_tokens.last().kind == WildcardToken::AnyString)
+                continue;
+        } else if (p[i] == QLatin1Char('?')) {
+            token.kind = WildcardToken::AnyChar;
+        } else if (p[i] == QLatin1Char('\\') && i + 1 < len) {
+            token.ch = p[++i].unicode();
+        } else if (p[i] == QLatin1Char('[')) {
+            int j = i + 1;
+            bool negated = false;
+            if (j < len && (p[j] == QLatin1Char('!') || p[j] == QLatin1Char('^'))) {
+                negated = true;
+                ++j;
+            }
+            // A ']' right after the opening bracket is part of the set
+            int end = j < len && p[j] == QLatin1Char(']') ? j + 1 : j;
+            while (end < len && p[end] != QLatin1Char(']'))
+                ++end;
+            if (end < len) {
+                token.kind = negated ? WildcardToken::NegatedSet : WildcardToken::Set;
+                token.firstRange = m_ranges.size() / 2;
+                while (j < end) {
+                    QChar first = p[j];
+                    QChar last = first;
+                    if (j + 2 < end && p[j + 1] == QLatin1Char('-')) {
+                        last = p[j + 2];
+                        j += 3;
+                    } else {
+                        ++j;
+                    }
+                    m_ranges.append(first);
+                    m_ranges.append(last);
+                    ++token.rangeCount;
+                }
+                i = end;
+            }
+            // else: no closing bracket, match '[' literally
+        }
+        m_tokens.append(token);
+    }
+}
+
+inline bool QMimeGlobPattern::matchToken(const WildcardToken &token, QChar c) const
+{
+    switch (token.kind) {
+    case WildcardToken::Char:
+        return c.unicode() == token.ch;
+    case WildcardToken::AnyChar:
+        return true;
+    case WildcardToken::Set:
+    case WildcardToken::NegatedSet: {
+        bool found = false;
+        const QChar *range = m_ranges.constData() + 2 * token.firstRange;
+        for (int i = 0; i < token.rangeCount && !found; ++i, range += 2)
+            found = c >= range[0] && c <= range[1];
+        return found != (token.kind == WildcardToken::NegatedSet);
+    }
+    }
+    return false;
+}
+
+/*!
+    \internal
+    Iterative glob matching: on a mismatch, backtrack to the last '*' and let it
+    swallow one more character. Case-insensitive patterns are stored lowercase,
+    the file name is lowercased one character at a time if \a fold is true.
+*/
+bool QMimeGlobPattern::matchWildcard(const QChar *name, int len, bool fold) const
+{
+    const WildcardToken *tokens = m_tokens.constData();
+    const int tokenCount = m_tokens.size();
+
+    int t = 0;
+    int s = 0;
+    int starToken = -1;
+    int starPos = 0;
+    while (s < len) {
+        if (t < tokenCount && tokens[t].kind == WildcardToken::AnyString) {
+            starToken = ++t;
+            starPos = s;
+        } else if (t < tokenCount && matchToken(tokens[t], fold ? name[s].toLower() : name[s])) {
+            ++t;
+            ++s;
+        } else if (starToken != -1) {
+            t = starToken;
+            s = ++starPos;
+        } else {
+            return false;
+        }
+    }
+    while (t < tokenCount && tokens[t].kind == WildcardToken::AnyString)
+        ++t;
+    return t == tokenCount;
+}
+
+static inline bool matchFixed(const QChar *name, const QString &literal, bool fold)
+{
+    const QChar *l = literal.unicode();
+    const int len = literal.length();
+    if (fold) {
+        for (int i = 0; i < len; ++i) {
+            if (name[i].toLower() != l[i])
+                return false;
+        }
+        return true;
+    }
+    for (int i = 0; i < len; ++i) {
+        if (name[i] != l[i])
+            return false;
+    }
+    return true;
+}
+
+bool QMimeGlobPattern::matchFileName(const QString &filename) const
 {
     // "Applications MUST match globs case-insensitively, except when the case-sensitive
     // attribute is set to true."
     // The constructor takes care of putting case-insensitive patterns in lowercase.
-    const QString filename = m_caseSensitivity == Qt::CaseInsensitive ? inputFilename.toLower() : inputFilename;
+    return match(filename.unicode(), filename.length(), m_caseSensitivity == Qt::CaseInsensitive);
+}
+
+/*!
+    \internal
+    Same as above, using the file name lowercased by \a context for case-insensitive patterns.
+*/
+bool QMimeGlobPattern::matchFileName(const QMimeGlobLookupContext &context) const
+{
+    const QString &filename = m_caseSensitivity == Qt::CaseInsensitive ? context.lowerFileName() : context.fileName();
+    return match(filename.unicode(), filename.length(), false);
+}
 
-    const int pattern_len = m_pattern.length();
-    if (!pattern_len)
+bool QMimeGlobPattern::match(const QChar *name, int len, bool fold) const
+{
+    const int literalLength = m_literal.length();
+
+    if (m_pattern.isEmpty())
         return false;
-    const int len = filename.length();
 
-    const int starCount = m_pattern.count(QLatin1Char('*'));
+    switch (m_patternType) {
+    case LiteralPattern:
+        return len == literalLength && matchFixed(name, m_literal, fold);
+    case SuffixPattern:
+        return len >= literalLength && matchFixed(name + len - literalLength, m_literal, fold);
+    case PrefixPattern:
+        return len >= literalLength && matchFixed(name, m_literal, fold);
+    case ContainsPattern:
+        for (int i = 0; i + literalLength <= len; ++i) {
+            if (matchFixed(name + i, m_literal, fold))
+                return true;
+        }
+        return false;
+    case WildcardPattern:
+        return matchWildcard(name, len, fold);
+    }
+    return false;
+}
 
-    // Patterns like "*~", "*.extension"
-    if (m_pattern[0] == QLatin1Char('*') && m_pattern.indexOf(QLatin1Char('[')) == -1 && starCount == 1)
-    {
-        if (len + 1 < pattern_len) return false;
+static QMimeGlobTableEntry tableEntry(const QMimeGlobPattern &glob)
+{
+    QMimeGlobTableEntry entry;
+    entry.mimeType = glob.mimeType();
+    entry.pattern = glob.pattern();
+    entry.fixedPart = glob.patternType() == QMimeGlobPattern::SuffixPattern ? glob.pattern().mid(1) : glob.pattern();
+    entry.weight = glob.weight();
+    entry.caseSensitive = glob.isCaseSensitive();
+    return entry;
+}
 
-        const QChar *c1 = m_pattern.unicode() + pattern_len - 1;
-        const QChar *c2 = filename.unicode() + len - 1;
-        int cnt = 1;
-        while (cnt < pattern_len && *c1-- == *c2--)
-            ++cnt;
-        return cnt == pattern_len;
+static void removeTableEntries(QVector<QMimeGlobTableEntry> &entries, const QString &mimeType)
+{
+    for (int i = entries.size() - 1; i >= 0; --i) {
+        if (entries.at(i).mimeType == mimeType)
+            entries.remove(i);
     }
+}
 
-    // Patterns like "README*" (well this is currently the only one like that...)
-    if (starCount == 1 && m_pattern.at(pattern_len - 1) == QLatin1Char('*')) {
-        if (len + 1 < pattern_len) return false;
-        if (m_pattern.at(0) == QLatin1Char('*'))
-            return filename.indexOf(m_pattern.midRef(1, pattern_len - 2)) != -1;
+// The tables are keyed by the lowercased file name; the file name ends with the fixed part
+// of each entry reached, ignoring case. Case-sensitive entries check the exact case here.
+static inline void addTableMatches(QMimeGlobMatchResult &result, const QMimeGlobLookupContext &context,
+                                   const QVector<QMimeGlobTableEntry> &entries)
+{
+    for (int i = 0; i < entries.size(); ++i) {
+        const QMimeGlobTableEntry &entry = entries.at(i);
+        if (entry.caseSensitive && !context.fileName().endsWith(entry.fixedPart))
+            continue;
+        result.addMatch(entry.mimeType, entry.weight, entry.pattern);
+    }
+}
+
+/*!
+    \internal
+    \class QMimeGlobLiteralTable
+    \brief The QMimeGlobLiteralTable class matches the glob patterns without wildcards with one hash lookup.
+*/
+
+void QMimeGlobLiteralTable::addGlob(const QMimeGlobPattern &glob)
+{
+    m_literals[glob.pattern().toLower()].append(tableEntry(glob));
+}
+
+void QMimeGlobLiteralTable::removeMimeType(const QString &mimeType)
+{
+    QMutableHashIterator<QString, QVector<QMimeGlobTableEntry> > it(m_literals);
+    while (it.hasNext())
+        removeTableEntries(it.next().value(), mimeType);
+}
 
-        const QChar *c1 = m_pattern.unicode();
-        const QChar *c2 = filename.unicode();
-        int cnt = 1;
-        while (cnt < pattern_len && *c1++ == *c2++)
-           ++cnt;
-        return cnt == pattern_len;
+void QMimeGlobLiteralTable::match(QMimeGlobMatchResult &result, const QMimeGlobLookupContext &context) const
+{
+    QHash<QString, QVector<QMimeGlobTableEntry> >::const_iterator it = m_literals.constFind(context.lowerFileName());
+    if (it != m_literals.constEnd())
+        addTableMatches(result, context, it.value());
+}
+
+/*!
+    \internal
+    \class QMimeGlobSuffixTree
+    \brief The QMimeGlobSuffixTree class matches all the "*suffix" glob patterns in one pass.
+
+    Each pattern is stored at the node reached by its suffix, lowercased and read
+    backwards from the root. Case-sensitive patterns share the nodes of the
+    case-insensitive ones and check the exact case of the file name when reached.
+*/
+
+void QMimeGlobSuffixTree::addGlob(const QMimeGlobPattern &glob)
+{
+    Q_ASSERT(glob.patternType() == QMimeGlobPattern::SuffixPattern);
+    const QString key = glob.pattern().toLower();
+
+    int node = 0;
+    for (int i = key.length() - 1; i > 0; --i) { // position 0 is the '*'
+        const quint64 edge = edgeKey(node, key.at(i));
+        QHash<quint64, int>::const_iterator it = m_edges.constFind(edge);
+        if (it == m_edges.constEnd()) {
+            const int child = m_nodeEntries.size();
+            m_nodeEntries.append(QVector<QMimeGlobTableEntry>());
+            m_edges.insert(edge, child);
+            node = child;
+        } else {
+            node = it.value();
+        }
     }
+    m_nodeEntries[node].append(tableEntry(glob));
+}
 
-    // Names without any wildcards like "README"
-    if (m_pattern.indexOf(QLatin1Char('[')) == -1 && starCount == 0 && m_pattern.indexOf(QLatin1Char('?')))
-        return (m_pattern == filename);
+void QMimeGlobSuffixTree::removeMimeType(const QString &mimeType)
+{
+    for (int node = 0; node < m_nodeEntries.size(); ++node)
+        removeTableEntries(m_nodeEntries[node], mimeType);
+}
 
-    // Other (quite rare) patterns, like "*.anim[1-9j]": use slow but correct method
-    const QRegExp rx(m_pattern, Qt::CaseSensitive, QRegExp::WildcardUnix);
-    return rx.exactMatch(filename);
+void QMimeGlobSuffixTree::match(QMimeGlobMatchResult &result, const QMimeGlobLookupContext &context) const
+{
+    const QString &lowerFileName = context.lowerFileName();
+    int node = 0;
+    addTableMatches(result, context, m_nodeEntries.at(node)); // "*"
+    for (int i = lowerFileName.length() - 1; i >= 0; --i) {
+        QHash<quint64, int>::const_iterator it = m_edges.constFind(edgeKey(node, lowerFileName.at(i)));
+        if (it == m_edges.constEnd())
+            break;
+        node = it.value();
+        addTableMatches(result, context, m_nodeEntries.at(node));
+    }
 }
 
-static bool isFastPattern(const QString &pattern)
+void QMimeGlobSuffixTree::clear()
 {
-   // starts with "*.", has no other '*' and no other '.'
-   return pattern.lastIndexOf(QLatin1Char('*')) == 0
-      && pattern.lastIndexOf(QLatin1Char('.')) == 1
-      // and contains no other special character
-      && !pattern.contains(QLatin1Char('?'))
-      && !pattern.contains(QLatin1Char('['))
-      ;
+    m_edges.clear();
+    m_nodeEntries.clear();
+    m_nodeEntries.append(QVector<QMimeGlobTableEntry>()); // the root
 }
 
 void QMimeAllGlobPatterns::addGlob(const QMimeGlobPattern &glob)
@@ -155,16 +446,15 @@ void QMimeAllGlobPatterns::addGlob(const QMimeGlobPattern &glob)
     const QString &pattern = glob.pattern();
     Q_ASSERT(!pattern.isEmpty());
 
-    // Store each patterns into either m_fastPatternDict (*.txt, *.html etc. with default weight 50)
-    // or for the rest, like core.*, *.tar.bz2, *~, into highWeightPatternOffset (>50)
-    // or lowWeightPatternOffset (<=50)
+    // Store each patterns into either the literals hash (Makefile, core), the suffix tree
+    // (*.txt, *.tar.bz2, *~ etc., whatever the weight) or for the rest, like core.*, README*,
+    // *.anim[1-9j], into highWeightPatternOffset (>50) or lowWeightPatternOffset (<=50)
 
-    if (glob.weight() == 50 && isFastPattern(pattern) && !glob.isCaseSensitive()) {
-        // The bulk of the patterns is *.foo with weight 50 --> those go into the fast patterns hash.
-        const QString extension = pattern.mid(2).toLower();
-        QStringList &patterns = m_fastPatterns[extension]; // find or create
-        // This would just slow things down: if (!patterns.contains(glob.mimeType()))
-        patterns.append(glob.mimeType());
+    if (glob.patternType() == QMimeGlobPattern::LiteralPattern) {
+        m_literals.addGlob(glob);
+    } else if (glob.patternType() == QMimeGlobPattern::SuffixPattern) {
+        // The bulk of the patterns is *.foo --> those go into the suffix tree.
+        m_suffixTree.addGlob(glob);
     } else {
         if (glob.weight() > 50) {
             // This would just slow things down: if (!m_highWeightGlobs.hasPattern(glob.mimeType(), glob.pattern()))
@@ -178,53 +468,47 @@ void QMimeAllGlobPatterns::addGlob(const QMimeGlobPattern &glob)
 
 void QMimeAllGlobPatterns::removeMimeType(const QString &mimeType)
 {
-    QMutableHashIterator<QString, QStringList> it(m_fastPatterns);
-    while (it.hasNext()) {
-        it.next().value().removeAll(mimeType);
-    }
+    m_literals.removeMimeType(mimeType);
+    m_suffixTree.removeMimeType(mimeType);
     m_highWeightGlobs.removeMimeType(mimeType);
     m_lowWeightGlobs.removeMimeType(mimeType);
 }
 
 void QMimeGlobPatternList::match(QMimeGlobMatchResult &result,
-                                 const QString &fileName) const
+                                 const QMimeGlobLookupContext &context) const
 {
 
     QMimeGlobPatternList::const_iterator it = this->constBegin();
     const QMimeGlobPatternList::const_iterator endIt = this->constEnd();
     for (; it != endIt; ++it) {
         const QMimeGlobPattern &glob = *it;
-        if (glob.matchFileName(fileName))
+        if (glob.matchFileName(context))
             result.addMatch(glob.mimeType(), glob.weight(), glob.pattern());
     }
 }
 
 QStringList QMimeAllGlobPatterns::matchingGlobs(const QString &fileName, QString *foundSuffix) const
 {
-    // First try the high weight matches (>50), if any.
+    // Lowercase the file name once, for all the case-insensitive patterns below
+    return matchingGlobs(QMimeGlobLookupContext(fileName), foundSuffix);
+}
+
+QStringList QMimeAllGlobPatterns::matchingGlobs(const QMimeGlobLookupContext &context, QString *foundSuffix) const
+{
+    // One hash lookup finds the literal matches, and one walk of the suffix tree all the
+    // "*suffix" matches, whatever their weight.
+    // QMimeGlobMatchResult keeps the highest weight, then the longest pattern.
     QMimeGlobMatchResult result;
-    m_highWeightGlobs.match(result, fileName);
-    if (result.m_matchingMimeTypes.isEmpty()) {
-
-        // Now use the "fast patterns" dict, for simple *.foo patterns with weight 50
-        // (which is most of them, so this optimization is definitely worth it)
-        const int lastDot = fileName.lastIndexOf(QLatin1Char('.'));
-        if (lastDot != -1) { // if no '.', skip the extension lookup
-            const int ext_len = fileName.length() - lastDot - 1;
-            const QString simpleExtension = fileName.right(ext_len).toLower();
-            // (toLower because fast patterns are always case-insensitive and saved as lowercase)
-
-            const QStringList matchingMimeTypes = m_fastPatterns.value(simpleExtension);
-            foreach (const QString &mime, matchingMimeTypes) {
-                result.addMatch(mime, 50, QLatin1String("*.") + simpleExtension);
-            }
-            // Can't return yet; *.tar.bz2 has to win over *.bz2, so we need the low-weight mimetypes anyway,
-            // at least those with weight 50.
-        }
+    m_literals.match(result, context);
+    m_suffixTree.match(result, context);
+
+    // Then the other high weight patterns (>50), if any.
+    m_highWeightGlobs.match(result, context);
+
+    // Finally, try the low weight matches (<=50), unless a higher weight already matched
+    if (result.m_weight <= 50)
+        m_lowWeightGlobs.match(result, context);
 
-        // Finally, try the low weight matches (<=50)
-        m_lowWeightGlobs.match(result, fileName);
-    }
     if (foundSuffix)
         *foundSuffix = result.m_foundSuffix;
     return result.m_matchingMimeTypes;
@@ -232,7 +516,8 @@ QStringList QMimeAllGlobPatterns::matchingGlobs(const QString &fileName, QString
 
 void QMimeAllGlobPatterns::clear()
 {
-    m_fastPatterns.clear();
+    m_literals.clear();
+    m_suffixTree.clear();
     m_highWeightGlobs.clear();
     m_lowWeightGlobs.clear();
 }
@@ -44,6 +44,7 @@
 
 #include <QtCore/qstringlist.h>
 #include <QtCore/qhash.h>
+#include <QtCore/qvector.h>
 
 QT_BEGIN_NAMESPACE
 
@@ -61,6 +62,28 @@ struct QMimeGlobMatchResult
     QString m_foundSuffix;
 };
 
+/*!
+    The file name being looked up, case-folded once for all the case-insensitive
+    patterns it is matched against.
+ */
+class QMimeGlobLookupContext
+{
+public:
+    QMimeGlobLookupContext() {}
+    explicit QMimeGlobLookupContext(const QString &fileName)
+        : m_fileName(fileName), m_lowerFileName(fileName.toLower())
+    {}
+
+    void setFileName(const QString &fileName);
+
+    inline const QString &fileName() const { return m_fileName; }
+    inline const QString &lowerFileName() const { return m_lowerFileName; }
+
+private:
+    QString m_fileName;
+    QString m_lowerFileName;
+};
+
 class QMimeGlobPattern
 {
 public:
@@ -74,21 +97,50 @@ public:
         if (s == Qt::CaseInsensitive) {
             m_pattern = m_pattern.toLower();
         }
+        compile();
     }
     ~QMimeGlobPattern() {}
 
     bool matchFileName(const QString &filename) const;
+    bool matchFileName(const QMimeGlobLookupContext &context) const;
 
     inline const QString &pattern() const { return m_pattern; }
     inline unsigned weight() const { return m_weight; }
     inline const QString &mimeType() const { return m_mimeType; }
     inline bool isCaseSensitive() const { return m_caseSensitivity == Qt::CaseSensitive; }
 
+    enum PatternType {
+        LiteralPattern,  // "README"
+        SuffixPattern,   // "*.txt", "*~"
+        PrefixPattern,   // "README*"
+        ContainsPattern, // "*foo*"
+        WildcardPattern  // anything else, e.g. "*.anim[1-9j]"
+    };
+    inline PatternType patternType() const { return m_patternType; }
+
 private:
+    struct WildcardToken
+    {
+        enum Kind { Char, AnyChar, AnyString, Set, NegatedSet };
+        ushort kind;
+        ushort ch;        // Char
+        int firstRange;   // Set, NegatedSet: index into m_ranges
+        int rangeCount;
+    };
+
+    void compile();
+    bool match(const QChar *name, int len, bool fold) const;
+    bool matchWildcard(const QChar *name, int len, bool fold) const;
+    bool matchToken(const WildcardToken &token, QChar c) const;
+
     QString m_pattern;
     QString m_mimeType;
     int m_weight;
     Qt::CaseSensitivity m_caseSensitivity;
+    PatternType m_patternType;
+    QString m_literal; // the fixed part of the non-wildcard pattern types
+    QVector<WildcardToken> m_tokens;
+    QVector<QChar> m_ranges; // pairs of first and last character of the [] sets
 };
 
 class QMimeGlobPatternList : public QList<QMimeGlobPattern>
@@ -116,29 +168,81 @@ public:
         }
     }
 
-    void match(QMimeGlobMatchResult &result, const QString &fileName) const;
+    void match(QMimeGlobMatchResult &result, const QMimeGlobLookupContext &context) const;
+};
+
+/*!
+    A glob stored in one of the tables below, which are keyed case-insensitively.
+ */
+struct QMimeGlobTableEntry
+{
+    QString mimeType;
+    QString pattern;
+    QString fixedPart; // pattern without the '*', for the case-sensitive check
+    int weight;
+    bool caseSensitive;
+};
+
+/*!
+    The globs without wildcards, like "Makefile" or "core", hashed by their
+    lowercased name, so that looking them up is a single hash lookup.
+ */
+class QMimeGlobLiteralTable
+{
+public:
+    void addGlob(const QMimeGlobPattern &glob);
+    void removeMimeType(const QString &mimeType);
+    void match(QMimeGlobMatchResult &result, const QMimeGlobLookupContext &context) const;
+    inline void clear() { m_literals.clear(); }
+    inline bool isEmpty() const { return m_literals.isEmpty(); }
+
+private:
+    QHash<QString, QVector<QMimeGlobTableEntry> > m_literals;
+};
+
+/*!
+    In-memory equivalent of the reverse suffix tree of mime.cache: all the "*suffix"
+    patterns, of any weight and case sensitivity, keyed by their lowercased suffix
+    read backwards. Matching walks the file name once, from its last character.
+ */
+class QMimeGlobSuffixTree
+{
+public:
+    QMimeGlobSuffixTree() { clear(); }
+
+    void addGlob(const QMimeGlobPattern &glob);
+    void removeMimeType(const QString &mimeType);
+    void match(QMimeGlobMatchResult &result, const QMimeGlobLookupContext &context) const;
+    void clear();
+
+private:
+    static inline quint64 edgeKey(int node, QChar c) { return (quint64(node) << 16) | c.unicode(); }
+
+    QHash<quint64, int> m_edges; // (node, character) -> child node
+    QVector<QVector<QMimeGlobTableEntry> > m_nodeEntries; // node -> patterns ending there, in insertion order
 };
 
 /*!
     Result of the globs parsing, as data structures ready for efficient MIME type matching.
     This contains:
-    1) a map of fast regular patterns (e.g. *.txt is stored as "txt" in a qhash's key)
-    2) a linear list of high-weight globs
-    3) a linear list of low-weight globs
+    1) a hash of the literal patterns (e.g. Makefile)
+    2) a reverse suffix tree for all "*suffix" patterns (e.g. *.txt, *.tar.bz2, *~)
+    3) a linear list of the other high-weight globs
+    4) a linear list of the other low-weight globs
  */
 class QMimeAllGlobPatterns
 {
 public:
-    typedef QHash<QString, QStringList> PatternsMap; // MIME type -> patterns
-
     void addGlob(const QMimeGlobPattern &glob);
     void removeMimeType(const QString &mimeType);
     QStringList matchingGlobs(const QString &fileName, QString *foundSuffix) const;
+    QStringList matchingGlobs(const QMimeGlobLookupContext &context, QString *foundSuffix) const;
     void clear();
 
-    PatternsMap m_fastPatterns; // example: "doc" -> "application/msword", "text/plain"
-    QMimeGlobPatternList m_highWeightGlobs;
-    QMimeGlobPatternList m_lowWeightGlobs; // <= 50, including the non-fast 50 patterns
+    QMimeGlobLiteralTable m_literals;
+    QMimeGlobSuffixTree m_suffixTree;
+    QMimeGlobPatternList m_highWeightGlobs; // > 50
+    QMimeGlobPatternList m_lowWeightGlobs; // <= 50
 };
 
 QT_END_NAMESPACE
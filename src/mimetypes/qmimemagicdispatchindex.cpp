@@ -0,0 +1,148 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtCore module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#define QT_NO_CAST_FROM_ASCII
+
+#include "qmimemagicdispatchindex_p.h"
+
+#include <QtCore/qalgorithms.h>
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \internal
+    \class QMimeMagicDispatchIndex
+
+    \brief The QMimeMagicDispatchIndex class finds the magic matchers which may match some data,
+    from the bytes at the offsets tested by their toplevel rules.
+
+    Most toplevel magic rules test a value at a single offset, usually 0. A matcher whose
+    toplevel rules are all like this can only match if the data has the first byte of one
+    of those values at the corresponding offset, so it is indexed by these (offset, byte) keys.
+    Matchers with any other toplevel rule (a range of offsets, or a mask on the first byte)
+    are always candidates.
+
+    \sa QMimeMagicRuleProgram, QMimeBinaryProvider
+*/
+
+QMimeMagicDispatchIndex::QMimeMagicDispatchIndex()
+    : m_matcherCount(0), m_built(false)
+{
+}
+
+void QMimeMagicDispatchIndex::addKey(int matcher, int offset, uchar byte)
+{
+    Key key;
+    key.offset = offset;
+    key.byte = byte;
+    key.matcher = matcher;
+    m_keys.append(key);
+    m_built = false;
+}
+
+void QMimeMagicDispatchIndex::addUnindexedMatcher(int matcher)
+{
+    m_unindexedMatchers.append(matcher);
+    m_built = false;
+}
+
+void QMimeMagicDispatchIndex::clear()
+{
+    m_keys.clear();
+    m_offsets.clear();
+    m_firstCandidate.clear();
+    m_candidates.clear();
+    m_unindexedMatchers.clear();
+    m_matcherCount = 0;
+    m_built = false;
+}
+
+/*!
+    Builds the index from the keys added so far, for matchers numbered from 0 to \a matcherCount - 1.
+ */
+void QMimeMagicDispatchIndex::build(int matcherCount)
+{
+    qSort(m_keys);
+    m_offsets.clear();
+    m_firstCandidate.clear();
+    m_candidates.clear();
+
+    for (int i = 0; i < m_keys.size(); ) {
+        const int offset = m_keys.at(i).offset;
+        m_offsets.append(offset);
+        for (int byte = 0; byte < 256; ++byte) {
+            m_firstCandidate.append(m_candidates.size());
+            for ( ; i < m_keys.size() && m_keys.at(i).offset == offset && m_keys.at(i).byte == byte; ++i)
+                m_candidates.append(m_keys.at(i).matcher);
+        }
+        m_firstCandidate.append(m_candidates.size());
+    }
+
+    m_keys.clear();
+    m_keys.squeeze();
+    m_offsets.squeeze();
+    m_firstCandidate.squeeze();
+    m_candidates.squeeze();
+    m_unindexedMatchers.squeeze();
+    m_matcherCount = matcherCount;
+    m_built = true;
+}
+
+/*!
+    Sets in \a candidates the bits of all the matchers which may match \a data.
+ */
+void QMimeMagicDispatchIndex::findCandidates(const char *data, int dataSize, QBitArray *candidates) const
+{
+    Q_ASSERT(m_built);
+    candidates->fill(false, m_matcherCount);
+    foreach (int matcher, m_unindexedMatchers)
+        candidates->setBit(matcher);
+    for (int i = 0; i < m_offsets.size(); ++i) {
+        const int offset = m_offsets.at(i);
+        if (offset >= dataSize)
+            break; // offsets are sorted
+        const int slot = i * 257 + uchar(data[offset]);
+        for (int c = m_firstCandidate.at(slot); c < m_firstCandidate.at(slot + 1); ++c)
+            candidates->setBit(m_candidates.at(c));
+    }
+}
+
+QT_END_NAMESPACE
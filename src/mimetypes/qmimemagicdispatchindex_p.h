@@ -0,0 +1,108 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtCore module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QMIMEMAGICDISPATCHINDEX_P_H
+#define QMIMEMAGICDISPATCHINDEX_P_H
+
+#include "qmime_global.h"
+
+#include <QtCore/qbitarray.h>
+#include <QtCore/qvector.h>
+
+QT_BEGIN_NAMESPACE
+
+class QMimeMagicDispatchIndex
+{
+public:
+    QMimeMagicDispatchIndex();
+
+    void addKey(int matcher, int offset, uchar byte);
+    void addUnindexedMatcher(int matcher);
+    void build(int matcherCount);
+    void clear();
+
+    bool isBuilt() const { return m_built; }
+
+    void findCandidates(const char *data, int dataSize, QBitArray *candidates) const;
+
+private:
+    struct Key
+    {
+        int offset;
+        int byte;
+        int matcher;
+
+        bool operator<(const Key &other) const
+        {
+            if (offset != other.offset)
+                return offset < other.offset;
+            if (byte != other.byte)
+                return byte < other.byte;
+            return matcher < other.matcher;
+        }
+    };
+
+    QVector<Key> m_keys;            // until build() is called
+    QVector<int> m_offsets;
+    QVector<int> m_firstCandidate;  // 257 entries per offset, into m_candidates
+    QVector<int> m_candidates;
+    QVector<int> m_unindexedMatchers;
+    int m_matcherCount;
+    bool m_built;
+};
+
+/*
+   Optional per-call instrumentation of a magic lookup, used by the unit test:
+   lookups without one count nothing and always use the dispatch index.
+ */
+struct QMimeMagicLookupStats
+{
+    QMimeMagicLookupStats() : useDispatchIndex(true), matcherCount(0), matchersEvaluated(0), rulesEvaluated(0) {}
+
+    bool useDispatchIndex;
+    int matcherCount;       // all the matchers of the provider
+    int matchersEvaluated;  // the ones tried before the lookup stopped
+    int rulesEvaluated;
+};
+
+QT_END_NAMESPACE
+
+#endif // QMIMEMAGICDISPATCHINDEX_P_H
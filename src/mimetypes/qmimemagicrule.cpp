@@ -43,6 +43,7 @@
 #define QT_NO_CAST_FROM_ASCII
 
 #include "qmimemagicrule_p.h"
+#include "qmimemagicsubstring_p.h"
 
 #include <QtCore/QList>
 #include <QtCore/QDebug>
@@ -96,7 +97,7 @@ public:
     quint32 number;
     quint32 numberMask;
 
-    typedef bool (*MatchFunction)(const QMimeMagicRulePrivate *d, const QByteArray &data);
+    typedef bool (*MatchFunction)(const QMimeMagicRulePrivate *d, const char *data, int dataSize);
     MatchFunction matchFunction;
 };
 
@@ -117,60 +118,18 @@ bool QMimeMagicRulePrivate::operator==(const QMimeMagicRulePrivate &other) const
 bool QMimeMagicRule::matchSubstring(const char *dataPtr, int dataSize, int rangeStart, int rangeLength,
                                     int valueLength, const char *valueData, const char *mask)
 {
-    // Size of searched data.
-    // Example: value="ABC", rangeLength=3 -> we need 3+3-1=5 bytes (ABCxx,xABCx,xxABC would match)
-    const int dataNeeded = qMin(rangeLength + valueLength - 1, dataSize - rangeStart);
-
-    if (!mask) {
-        // callgrind says QByteArray::indexOf is much slower, since our strings are typically too
-        // short for be worth Boyer-Moore matching (1 to 71 bytes, 11 bytes on average).
-        bool found = false;
-        for (int i = rangeStart; i < rangeStart + rangeLength; ++i) {
-            if (i + valueLength > dataSize)
-                break;
-
-            if (memcmp(valueData, dataPtr + i, valueLength) == 0) {
-                found = true;
-                break;
-            }
-        }
-        if (!found)
-            return false;
-    } else {
-        bool found = false;
-        const char *readDataBase = dataPtr + rangeStart;
-        // Example (continued from above):
-        // deviceSize is 4, so dataNeeded was max'ed to 4.
-        // maxStartPos = 4 - 3 + 1 = 2, and indeed
-        // we need to check for a match a positions 0 and 1 (ABCx and xABC).
-        const int maxStartPos = dataNeeded - valueLength + 1;
-        for (int i = 0; i < maxStartPos; ++i) {
-            const char *d = readDataBase + i;
-            bool valid = true;
-            for (int idx = 0; idx < valueLength; ++idx) {
-                if (((*d++) & mask[idx]) != (valueData[idx] & mask[idx])) {
-                    valid = false;
-                    break;
-                }
-            }
-            if (valid)
-                found = true;
-        }
-        if (!found)
-            return false;
-    }
-    //qDebug() << "Found" << value << "in" << searchedData;
-    return true;
+    // Uses SSE2 or AVX2 when available, see qmimemagicsubstring.cpp
+    return qmime_bestSubstringMatcher()(dataPtr, dataSize, rangeStart, rangeLength, valueLength, valueData, mask);
 }
 
-static bool matchString(const QMimeMagicRulePrivate *d, const QByteArray &data)
+static bool matchString(const QMimeMagicRulePrivate *d, const char *data, int dataSize)
 {
     const int rangeLength = d->endPos - d->startPos + 1;
-    return QMimeMagicRule::matchSubstring(data.constData(), data.size(), d->startPos, rangeLength, d->pattern.size(), d->pattern.constData(), d->mask.constData());
+    return QMimeMagicRule::matchSubstring(data, dataSize, d->startPos, rangeLength, d->pattern.size(), d->pattern.constData(), d->mask.constData());
 }
 
 template <typename T>
-static bool matchNumber(const QMimeMagicRulePrivate *d, const QByteArray &data)
+static bool matchNumber(const QMimeMagicRulePrivate *d, const char *data, int dataSize)
 {
     const T value(d->number);
     const T mask(d->numberMask);
@@ -178,8 +137,8 @@ static bool matchNumber(const QMimeMagicRulePrivate *d, const QByteArray &data)
     //qDebug() << "matchNumber" << "0x" << QString::number(d->number, 16) << "size" << sizeof(T);
     //qDebug() << "mask" << QString::number(d->numberMask, 16);
 
-    const char *p = data.constData() + d->startPos;
-    const char *e = data.constData() + qMin(data.size() - int(sizeof(T)), d->endPos + 1);
+    const char *p = data + d->startPos;
+    const char *e = data + qMin(dataSize - int(sizeof(T)), d->endPos + 1);
     for ( ; p <= e; ++p) {
         if ((*reinterpret_cast<const T*>(p) & mask) == (value & mask))
             return true;
@@ -355,14 +314,73 @@ QByteArray QMimeMagicRule::mask() const
     return result;
 }
 
+template <typename T>
+static inline QByteArray numberBytes(quint32 number)
+{
+    // Same in-memory representation as the one compared by matchNumber<T>
+    const T value(number);
+    return QByteArray(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+/*!
+    Returns the bytes which are compared with the data, in the same form as
+    the values of the mime.cache magic section: the unescaped pattern for
+    strings, the number in the order it is read from the data otherwise.
+ */
+QByteArray QMimeMagicRule::matchValue() const
+{
+    switch (d->type) {
+    case String:
+        return d->pattern;
+    case Byte:
+        return numberBytes<quint8>(d->number);
+    case Big16:
+    case Host16:
+    case Little16:
+        return numberBytes<quint16>(d->number);
+    case Big32:
+    case Host32:
+    case Little32:
+        return numberBytes<quint32>(d->number);
+    default:
+        break;
+    }
+    return QByteArray();
+}
+
+/*!
+    Returns the mask applied to the data before comparing it with matchValue(),
+    with the same size as matchValue().
+ */
+QByteArray QMimeMagicRule::matchMask() const
+{
+    switch (d->type) {
+    case String:
+        return d->mask;
+    case Byte:
+        return numberBytes<quint8>(d->numberMask);
+    case Big16:
+    case Host16:
+    case Little16:
+        return numberBytes<quint16>(d->numberMask);
+    case Big32:
+    case Host32:
+    case Little32:
+        return numberBytes<quint32>(d->numberMask);
+    default:
+        break;
+    }
+    return QByteArray();
+}
+
 bool QMimeMagicRule::isValid() const
 {
     return d->matchFunction;
 }
 
-bool QMimeMagicRule::matches(const QByteArray &data) const
+bool QMimeMagicRule::matches(const char *data, int dataSize) const
 {
-    const bool ok = d->matchFunction && d->matchFunction(d.data(), data);
+    const bool ok = d->matchFunction && d->matchFunction(d.data(), data, dataSize);
     if (!ok)
         return false;
 
@@ -374,7 +392,7 @@ bool QMimeMagicRule::matches(const QByteArray &data) const
     // Check that one of the submatches matches too
     for ( QList<QMimeMagicRule>::const_iterator it = m_subMatches.begin(), end = m_subMatches.end() ;
           it != end ; ++it ) {
-        if ((*it).matches(data)) {
+        if ((*it).matches(data, dataSize)) {
             // One of the hierarchies matched -> mimetype recognized.
             return true;
         }
@@ -68,9 +68,12 @@ public:
     int endPos() const;
     QByteArray mask() const;
 
+    QByteArray matchValue() const;
+    QByteArray matchMask() const;
+
     bool isValid() const;
 
-    bool matches(const QByteArray &data) const;
+    bool matches(const char *data, int dataSize) const;
 
     QList<QMimeMagicRule> m_subMatches;
 
@@ -88,10 +88,10 @@ QList<QMimeMagicRule> QMimeMagicRuleMatcher::magicRules() const
 }
 
 // Check for a match on contents of a file
-bool QMimeMagicRuleMatcher::matches(const QByteArray &data) const
+bool QMimeMagicRuleMatcher::matches(const char *data, int dataSize) const
 {
     foreach (const QMimeMagicRule &magicRule, m_list) {
-        if (magicRule.matches(data))
+        if (magicRule.matches(data, dataSize))
             return true;
     }
 
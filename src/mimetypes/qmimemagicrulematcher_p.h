@@ -61,7 +61,7 @@ public:
     void addRules(const QList<QMimeMagicRule> &rules);
     QList<QMimeMagicRule> magicRules() const;
 
-    bool matches(const QByteArray &data) const;
+    bool matches(const char *data, int dataSize) const;
 
     unsigned priority() const;
 
@@ -0,0 +1,347 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtCore module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#define QT_NO_CAST_FROM_ASCII
+
+#include "qmimemagicruleprogram_p.h"
+
+#include "qmimemagicrule_p.h"
+#include "qmimemagicrulematcher_p.h"
+
+#include <QtCore/qmap.h>
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \internal
+    \class QMimeMagicRuleProgram
+
+    \brief The QMimeMagicRuleProgram class holds all the magic rules parsed from XML files
+    in a flat form.
+
+    Each QMimeMagicRuleMatcher added is compiled into a contiguous range of rules,
+    stored in pre-order: every rule knows its range, the indexes of its value and mask
+    in a shared byte array, and the index of the rule following its subtree.
+    This is the same information as in the magic section of mime.cache, and it allows
+    to check a matcher with a simple loop instead of walking the QMimeMagicRule trees.
+
+    The values of the unmasked rules which scan a range of offsets are also given to a
+    QMimeMagicStringScanner, so that they are all searched for in one pass over the data,
+    the first time one of them is needed.
+
+    Finally a QMimeMagicDispatchIndex, built from the toplevel rules of each matcher,
+    allows to skip the matchers which cannot match the first bytes of the data.
+
+    Matchers are tried by decreasing priority, so that the search can stop at the first
+    match: no later matcher could have a higher priority.
+
+    \sa QMimeMagicRuleMatcher, QMimeMagicRule, QMimeXMLProvider
+*/
+
+QMimeMagicRuleProgram::QMimeMagicRuleProgram()
+    : m_maxExtent(0)
+{
+}
+
+static bool isFullMask(const QByteArray &mask)
+{
+    const char *p = mask.constData();
+    const char *e = p + mask.size();
+    for ( ; p < e; ++p) {
+        if (*p != char(-1))
+            return false;
+    }
+    return true;
+}
+
+void QMimeMagicRuleProgram::addRule(const QMimeMagicRule &rule)
+{
+    const int index = m_rules.size();
+
+    Rule compiled;
+    compiled.rangeStart = rule.startPos();
+    compiled.rangeLength = rule.endPos() - rule.startPos() + 1;
+    compiled.valueLength = 0;
+    compiled.valueIndex = 0;
+    compiled.maskIndex = -1;
+    compiled.scanPattern = -1;
+    compiled.numChildren = rule.m_subMatches.count();
+    compiled.next = index + 1;
+
+    if (rule.isValid()) {
+        const QByteArray value = rule.matchValue();
+        const QByteArray mask = rule.matchMask();
+        compiled.valueLength = value.size();
+        compiled.valueIndex = m_bytes.size();
+        m_bytes.append(value);
+        // Unmasked rules can use the faster memcmp code path
+        if (mask.size() == value.size() && !isFullMask(mask)) {
+            compiled.maskIndex = m_bytes.size();
+            m_bytes.append(mask);
+        } else if (compiled.rangeLength > 1) {
+            compiled.scanPattern = m_scanner.addPattern(value, rule.endPos());
+        }
+    }
+    m_rules.append(compiled);
+
+    foreach (const QMimeMagicRule &child, rule.m_subMatches)
+        addRule(child);
+    m_rules[index].next = m_rules.size();
+}
+
+void QMimeMagicRuleProgram::addMatcher(const QMimeMagicRuleMatcher &matcher)
+{
+    const QString mimeType = matcher.mimetype();
+    QHash<QString, int>::const_iterator it = m_mimeIndexes.constFind(mimeType);
+    if (it == m_mimeIndexes.constEnd()) {
+        it = m_mimeIndexes.insert(mimeType, m_mimeTypes.size());
+        m_mimeTypes.append(mimeType);
+    }
+
+    Matcher compiled;
+    compiled.firstRule = m_rules.size();
+    foreach (const QMimeMagicRule &rule, matcher.magicRules())
+        addRule(rule);
+    compiled.endRule = m_rules.size();
+    compiled.extent = 0;
+    for (int i = compiled.firstRule; i < compiled.endRule; ++i) {
+        const Rule &rule = m_rules.at(i);
+        if (rule.valueLength)
+            compiled.extent = qMax(compiled.extent, rule.rangeStart + rule.rangeLength - 1 + rule.valueLength);
+    }
+    m_maxExtent = qMax(m_maxExtent, compiled.extent);
+    compiled.priority = matcher.priority();
+    compiled.mimeIndex = it.value();
+    m_matchers.append(compiled);
+    indexMatcher(m_matchers.size() - 1);
+}
+
+void QMimeMagicRuleProgram::indexMatcher(int matcher)
+{
+    const Matcher &m = m_matchers.at(matcher);
+    bool indexed = true;
+    for (int i = m.firstRule; i < m.endRule; i = m_rules.at(i).next) {
+        const Rule &rule = m_rules.at(i);
+        if (!rule.valueLength)
+            continue; // never matches
+        if (rule.rangeLength != 1 || (rule.maskIndex != -1 && uchar(m_bytes.at(rule.maskIndex)) != 0xff)) {
+            indexed = false;
+            break;
+        }
+    }
+    if (!indexed) {
+        m_dispatchIndex.addUnindexedMatcher(matcher);
+        return;
+    }
+    for (int i = m.firstRule; i < m.endRule; i = m_rules.at(i).next) {
+        const Rule &rule = m_rules.at(i);
+        if (rule.valueLength)
+            m_dispatchIndex.addKey(matcher, rule.rangeStart, m_bytes.at(rule.valueIndex));
+    }
+}
+
+void QMimeMagicRuleProgram::clear()
+{
+    m_rules.clear();
+    m_matchers.clear();
+    m_bytes.clear();
+    m_scanner.clear();
+    m_dispatchIndex.clear();
+    m_order.clear();
+    m_maxExtent = 0;
+    m_mimeTypes.clear();
+    m_mimeIndexes.clear();
+}
+
+/*!
+    Prepares the program for matching, once all the matchers were added.
+ */
+void QMimeMagicRuleProgram::build()
+{
+    m_rules.squeeze();
+    m_matchers.squeeze();
+    m_bytes.squeeze();
+    m_scanner.build();
+    m_dispatchIndex.build(m_matchers.size());
+
+    // Stable, so that the first matcher wins among those with the same priority
+    QMap<unsigned, QVector<int> > byPriority;
+    for (int i = 0; i < m_matchers.size(); ++i)
+        byPriority[m_matchers.at(i).priority].append(i);
+    m_order.clear();
+    m_order.reserve(m_matchers.size());
+    QMap<unsigned, QVector<int> >::const_iterator it = byPriority.constEnd();
+    while (it != byPriority.constBegin()) {
+        --it;
+        m_order += it.value();
+    }
+}
+
+// Check for a match on contents of a file
+bool QMimeMagicRuleProgram::matches(int matcher, const char *data, int dataSize) const
+{
+    QMimeMagicStringScanner::Result scanResult;
+    return matches(matcher, data, dataSize, &scanResult, 0);
+}
+
+bool QMimeMagicRuleProgram::matches(int matcher, const char *data, int dataSize, QMimeMagicStringScanner::Result *scanResult, QMimeMagicLookupStats *stats) const
+{
+    const Matcher &m = m_matchers.at(matcher);
+    const Rule *rules = m_rules.constData();
+    const char *bytes = m_bytes.constData();
+
+    // A matcher matches when all the rules on a path from one of its
+    // toplevel rules down to a rule without children match.
+    int i = m.firstRule;
+    while (i < m.endRule) {
+        const Rule &rule = rules[i];
+        if (stats)
+            ++stats->rulesEvaluated;
+        bool matched;
+        if (rule.scanPattern != -1 && m_scanner.isBuilt()) {
+            if (!scanResult->scanned)
+                m_scanner.scan(data, dataSize, scanResult);
+            matched = scanResult->contains(rule.scanPattern, rule.rangeStart, rule.rangeLength);
+        } else {
+            matched = rule.valueLength
+                && QMimeMagicRule::matchSubstring(data, dataSize, rule.rangeStart, rule.rangeLength,
+                                                  rule.valueLength, bytes + rule.valueIndex,
+                                                  rule.maskIndex == -1 ? 0 : bytes + rule.maskIndex);
+        }
+        if (matched) {
+            if (!rule.numChildren)
+                return true;
+            ++i; // check the first child
+        } else {
+            i = rule.next; // skip the children, check the next sibling
+        }
+    }
+    return false;
+}
+
+/*!
+    Returns the MIME type of the matcher with the highest priority matching \a data,
+    provided that priority is higher than *\a accuracyPtr, which is then updated.
+    Returns an empty string if there is no such matcher.
+    The optional \a stats are filled in for the unit test.
+ */
+QString QMimeMagicRuleProgram::findMatch(const char *data, int dataSize, int *accuracyPtr, QMimeMagicLookupStats *stats) const
+{
+    const bool useIndex = (!stats || stats->useDispatchIndex) && m_dispatchIndex.isBuilt();
+    QBitArray candidates;
+    if (useIndex)
+        m_dispatchIndex.findCandidates(data, dataSize, &candidates);
+
+    if (stats)
+        stats->matcherCount += m_matchers.size();
+
+    QMimeMagicStringScanner::Result scanResult;
+    Q_ASSERT(m_order.size() == m_matchers.size()); // build() was called
+    foreach (int i, m_order) {
+        const int priority = m_matchers.at(i).priority;
+        if (priority <= *accuracyPtr)
+            break; // none of the remaining matchers can do better
+        if (useIndex && !candidates.testBit(i))
+            continue;
+        if (stats)
+            ++stats->matchersEvaluated;
+        if (matches(i, data, dataSize, &scanResult, stats)) {
+            *accuracyPtr = priority;
+            return mimeType(i);
+        }
+    }
+    return QString();
+}
+
+// Like matches(), but for data which may still be incomplete: a rule which didn't
+// match is only known to never match if all the bytes it looks at are available.
+QMimeMagicRuleProgram::MatchState QMimeMagicRuleProgram::matchState(int firstRule, int endRule, const char *data, int dataSize) const
+{
+    MatchState result = NoMatch;
+    for (int i = firstRule; i < endRule; i = m_rules.at(i).next) {
+        const Rule &rule = m_rules.at(i);
+        MatchState state;
+        if (!rule.valueLength) {
+            state = NoMatch;
+        } else if (QMimeMagicRule::matchSubstring(data, dataSize, rule.rangeStart, rule.rangeLength,
+                                                  rule.valueLength, m_bytes.constData() + rule.valueIndex,
+                                                  rule.maskIndex == -1 ? 0 : m_bytes.constData() + rule.maskIndex)) {
+            state = Match;
+        } else {
+            state = rule.rangeStart + rule.rangeLength - 1 + rule.valueLength <= dataSize ? NoMatch : Undecided;
+        }
+        if (state != NoMatch && rule.numChildren) {
+            const MatchState children = matchState(i + 1, rule.next, data, dataSize);
+            if (children != Match)
+                state = children == NoMatch ? NoMatch : Undecided;
+        }
+        if (state == Match)
+            return Match;
+        if (state == Undecided)
+            result = Undecided;
+    }
+    return result;
+}
+
+/*!
+    Returns the data size from which more data cannot change the result of
+    findMatch() anymore, or 0 if \a data is already enough.
+
+    More data can only make more rules match, so the result can only change because of
+    a matcher which is still undecided and has at least the priority of the current match.
+ */
+int QMimeMagicRuleProgram::dataNeeded(const char *data, int dataSize) const
+{
+    int accuracy = 0;
+    findMatch(data, dataSize, &accuracy);
+
+    int needed = 0;
+    for (int i = 0; i < m_matchers.size(); ++i) {
+        const Matcher &m = m_matchers.at(i);
+        if (int(m.priority) < accuracy || m.extent <= needed)
+            continue;
+        if (matchState(m.firstRule, m.endRule, data, dataSize) == Undecided)
+            needed = m.extent;
+    }
+    return needed;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,122 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtCore module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QMIMEMAGICRULEPROGRAM_P_H
+#define QMIMEMAGICRULEPROGRAM_P_H
+
+#include <QtCore/qbytearray.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qstringlist.h>
+#include <QtCore/qvector.h>
+
+#include "qmimemagicdispatchindex_p.h"
+#include "qmimemagicstringscanner_p.h"
+
+QT_BEGIN_NAMESPACE
+
+class QMimeMagicRule;
+class QMimeMagicRuleMatcher;
+
+class QMimeMagicRuleProgram
+{
+public:
+    QMimeMagicRuleProgram();
+
+    void addMatcher(const QMimeMagicRuleMatcher &matcher);
+    void clear();
+    void build();
+
+    int matcherCount() const { return m_matchers.size(); }
+    int maxExtent() const { return m_maxExtent; }
+    unsigned priority(int matcher) const { return m_matchers.at(matcher).priority; }
+    QString mimeType(int matcher) const { return m_mimeTypes.at(m_matchers.at(matcher).mimeIndex); }
+
+    bool matches(int matcher, const char *data, int dataSize) const;
+    QString findMatch(const char *data, int dataSize, int *accuracyPtr, QMimeMagicLookupStats *stats = 0) const;
+    int dataNeeded(const char *data, int dataSize) const;
+
+private:
+    bool matches(int matcher, const char *data, int dataSize, QMimeMagicStringScanner::Result *scanResult, QMimeMagicLookupStats *stats) const;
+
+    enum MatchState { NoMatch, Match, Undecided };
+    MatchState matchState(int firstRule, int endRule, const char *data, int dataSize) const;
+
+    // One <match> element. The rules of a matcher are stored in pre-order,
+    // so the children of a rule directly follow it and 'next' skips them.
+    struct Rule
+    {
+        int rangeStart;
+        int rangeLength;
+        int valueLength;    // 0 for a rule which can never match
+        int valueIndex;     // into m_bytes
+        int maskIndex;      // into m_bytes, -1 if unmasked
+        int scanPattern;    // into m_scanner, -1 if checked with matchSubstring
+        int numChildren;
+        int next;           // index of the first rule after this subtree
+    };
+
+    // One <magic> element
+    struct Matcher
+    {
+        int firstRule;
+        int endRule;
+        unsigned priority;
+        int extent;         // number of bytes needed by the rule reading furthest
+        int mimeIndex;      // into m_mimeTypes
+    };
+
+    void addRule(const QMimeMagicRule &rule);
+    void indexMatcher(int matcher);
+
+    QVector<Rule> m_rules;
+    QVector<Matcher> m_matchers;
+    QByteArray m_bytes;
+    QMimeMagicStringScanner m_scanner;
+    QMimeMagicDispatchIndex m_dispatchIndex;
+    QVector<int> m_order;   // matchers by decreasing priority
+    int m_maxExtent;        // number of bytes needed by the rule reading furthest
+    QStringList m_mimeTypes;
+    QHash<QString, int> m_mimeIndexes;
+};
+
+QT_END_NAMESPACE
+
+#endif // QMIMEMAGICRULEPROGRAM_P_H
@@ -0,0 +1,259 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtCore module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#define QT_NO_CAST_FROM_ASCII
+
+#include "qmimemagicstringscanner_p.h"
+
+#include <QtCore/qmap.h>
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \internal
+    \class QMimeMagicStringScanner
+
+    \brief The QMimeMagicStringScanner class finds all the values of ranged magic rules
+    in a buffer in a single pass.
+
+    Many magic rules look for a value anywhere in a range of offsets, e.g. "0:256".
+    Instead of comparing each of those values at each offset of its range, the values
+    are compiled into an Aho-Corasick automaton which runs once over the beginning of
+    the data and records where each value occurs. A rule then only has to check that
+    one of the occurrences of its value starts within its range.
+
+    Only exact byte values are supported, masked rules still need QMimeMagicRule::matchSubstring.
+
+    \sa QMimeMagicRuleProgram, QMimeBinaryProvider
+*/
+
+QMimeMagicStringScanner::QMimeMagicStringScanner()
+    : m_scanLimit(0), m_built(false)
+{
+}
+
+/*!
+    Adds \a pattern, which must start at an offset not after \a lastStartPos to be of
+    interest, and returns its index. Identical patterns share the same index.
+ */
+int QMimeMagicStringScanner::addPattern(const QByteArray &pattern, int lastStartPos)
+{
+    Q_ASSERT(!pattern.isEmpty());
+    m_built = false;
+    QHash<QByteArray, int>::const_iterator it = m_patternIndexes.constFind(pattern);
+    if (it != m_patternIndexes.constEnd()) {
+        Pattern &existing = m_patterns[it.value()];
+        existing.lastStartPos = qMax(existing.lastStartPos, lastStartPos);
+        return it.value();
+    }
+    Pattern p;
+    p.value = pattern;
+    p.lastStartPos = lastStartPos;
+    m_patterns.append(p);
+    m_patternIndexes.insert(pattern, m_patterns.size() - 1);
+    return m_patterns.size() - 1;
+}
+
+void QMimeMagicStringScanner::clear()
+{
+    m_patterns.clear();
+    m_patternIndexes.clear();
+    m_states.clear();
+    m_edges.clear();
+    m_scanLimit = 0;
+    m_built = false;
+}
+
+/*!
+    Builds the automaton from the patterns added so far.
+ */
+void QMimeMagicStringScanner::build()
+{
+    m_states.clear();
+    m_edges.clear();
+    m_scanLimit = 0;
+
+    // The trie of all patterns, state 0 being the root
+    QVector<QMap<uchar, int> > children(1);
+    QVector<int> outputs(1, -1);
+    for (int i = 0; i < m_patterns.size(); ++i) {
+        const Pattern &pattern = m_patterns.at(i);
+        int state = 0;
+        for (int pos = 0; pos < pattern.value.size(); ++pos) {
+            const uchar byte = pattern.value.at(pos);
+            int next = children.at(state).value(byte, -1);
+            if (next == -1) {
+                next = children.size();
+                children[state].insert(byte, next);
+                children.append(QMap<uchar, int>());
+                outputs.append(-1);
+            }
+            state = next;
+        }
+        outputs[state] = i;
+        m_scanLimit = qMax(m_scanLimit, pattern.lastStartPos + pattern.value.size());
+    }
+
+    // Flatten the transitions, children are visited in breadth-first order
+    // so that the fail link of a state is always computed before its own children
+    m_states.resize(children.size());
+    for (int state = 0; state < children.size(); ++state) {
+        State &s = m_states[state];
+        s.firstEdge = m_edges.size();
+        s.edgeCount = children.at(state).size();
+        s.fail = 0;
+        s.output = outputs.at(state);
+        s.outputLink = -1;
+        QMap<uchar, int>::const_iterator it = children.at(state).constBegin();
+        for ( ; it != children.at(state).constEnd(); ++it) {
+            Edge edge;
+            edge.byte = it.key();
+            edge.target = it.value();
+            m_edges.append(edge);
+        }
+    }
+    for (int byte = 0; byte < 256; ++byte)
+        m_rootEdges[byte] = 0;
+    for (int e = 0; e < m_states.at(0).edgeCount; ++e)
+        m_rootEdges[m_edges.at(e).byte] = m_edges.at(e).target;
+
+    QVector<int> queue;
+    for (int e = 0; e < m_states.at(0).edgeCount; ++e)
+        queue.append(m_edges.at(e).target);
+    for (int head = 0; head < queue.size(); ++head) {
+        const int state = queue.at(head);
+        const State s = m_states.at(state);
+        for (int e = s.firstEdge; e < s.firstEdge + s.edgeCount; ++e) {
+            const uchar byte = m_edges.at(e).byte;
+            const int child = m_edges.at(e).target;
+            int fail = s.fail;
+            int target = findEdge(fail, byte);
+            while (target == -1 && fail != 0) {
+                fail = m_states.at(fail).fail;
+                target = findEdge(fail, byte);
+            }
+            State &c = m_states[child];
+            c.fail = target == -1 ? 0 : target;
+            const State &f = m_states.at(c.fail);
+            c.outputLink = f.output != -1 ? c.fail : f.outputLink;
+            queue.append(child);
+        }
+    }
+
+    m_states.squeeze();
+    m_edges.squeeze();
+    m_built = true;
+}
+
+int QMimeMagicStringScanner::findEdge(int state, uchar byte) const
+{
+    if (state == 0) {
+        const int target = m_rootEdges[byte];
+        return target ? target : -1;
+    }
+    const State &s = m_states.at(state);
+    const Edge *first = m_edges.constData() + s.firstEdge;
+    const Edge *last = first + s.edgeCount;
+    for (const Edge *edge = first; edge != last; ++edge) {
+        if (edge->byte == byte)
+            return edge->target;
+        if (edge->byte > byte)
+            break;
+    }
+    return -1;
+}
+
+/*!
+    Records in \a result all the occurrences of the patterns in the first bytes of \a data
+    which can be of interest, i.e. which start at or before the last start position of the pattern.
+ */
+void QMimeMagicStringScanner::scan(const char *data, int dataSize, Result *result) const
+{
+    Q_ASSERT(m_built);
+    result->lastHit.fill(-1, m_patterns.size());
+    result->hits.clear();
+    result->scanned = true;
+
+    const State *states = m_states.constData();
+    const Pattern *patterns = m_patterns.constData();
+    const int end = qMin(dataSize, m_scanLimit);
+    int state = 0;
+    for (int pos = 0; pos < end; ++pos) {
+        const uchar byte = data[pos];
+        int next = findEdge(state, byte);
+        while (next == -1 && state != 0) {
+            state = states[state].fail;
+            next = findEdge(state, byte);
+        }
+        state = next == -1 ? 0 : next;
+
+        int out = states[state].output != -1 ? state : states[state].outputLink;
+        while (out != -1) {
+            const int pattern = states[out].output;
+            const int start = pos + 1 - patterns[pattern].value.size();
+            if (start <= patterns[pattern].lastStartPos) {
+                Hit hit;
+                hit.start = start;
+                hit.previous = result->lastHit.at(pattern);
+                result->lastHit[pattern] = result->hits.size();
+                result->hits.append(hit);
+            }
+            out = states[out].outputLink;
+        }
+    }
+}
+
+/*!
+    Returns true if an occurrence of \a pattern starts in the given range.
+ */
+bool QMimeMagicStringScanner::Result::contains(int pattern, int rangeStart, int rangeLength) const
+{
+    // Hits are chained from the last one, i.e. by decreasing start position
+    for (int hit = lastHit.at(pattern); hit != -1; hit = hits.at(hit).previous) {
+        const int start = hits.at(hit).start;
+        if (start >= rangeStart + rangeLength)
+            continue;
+        return start >= rangeStart;
+    }
+    return false;
+}
+
+QT_END_NAMESPACE
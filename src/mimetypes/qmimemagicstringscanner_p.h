@@ -0,0 +1,118 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtCore module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QMIMEMAGICSTRINGSCANNER_P_H
+#define QMIMEMAGICSTRINGSCANNER_P_H
+
+#include <QtCore/qbytearray.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qvector.h>
+
+QT_BEGIN_NAMESPACE
+
+class QMimeMagicStringScanner
+{
+public:
+    struct Hit
+    {
+        int start;
+        int previous;       // previous hit of the same pattern, -1 if none
+    };
+
+    // The occurrences found in one buffer, filled on demand by scan()
+    struct Result
+    {
+        Result() : scanned(false) {}
+
+        bool contains(int pattern, int rangeStart, int rangeLength) const;
+
+        QVector<int> lastHit;   // per pattern, index into hits, -1 if none
+        QVector<Hit> hits;
+        bool scanned;
+    };
+
+    QMimeMagicStringScanner();
+
+    int addPattern(const QByteArray &pattern, int lastStartPos);
+    void build();
+    void clear();
+
+    bool isBuilt() const { return m_built; }
+    int patternCount() const { return m_patterns.size(); }
+
+    void scan(const char *data, int dataSize, Result *result) const;
+
+private:
+    struct Pattern
+    {
+        QByteArray value;
+        int lastStartPos;
+    };
+
+    struct State
+    {
+        int firstEdge;      // into m_edges, sorted by byte
+        int edgeCount;
+        int fail;
+        int output;         // pattern ending in this state, -1 if none
+        int outputLink;     // next state on the fail chain with an output, -1 if none
+    };
+
+    struct Edge
+    {
+        uchar byte;
+        int target;
+    };
+
+    int findEdge(int state, uchar byte) const;
+
+    QVector<Pattern> m_patterns;
+    QHash<QByteArray, int> m_patternIndexes;
+    QVector<State> m_states;
+    QVector<Edge> m_edges;
+    int m_rootEdges[256];
+    int m_scanLimit;
+    bool m_built;
+};
+
+QT_END_NAMESPACE
+
+#endif // QMIMEMAGICSTRINGSCANNER_P_H
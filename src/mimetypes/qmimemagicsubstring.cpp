@@ -0,0 +1,218 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtCore module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qmimemagicsubstring_p.h"
+
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#  define QMIME_HAVE_SSE2
+#  if defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
+#    define QMIME_HAVE_AVX2
+#  endif
+#endif
+
+#if defined(QMIME_HAVE_AVX2)
+#  include <immintrin.h>
+#elif defined(QMIME_HAVE_SSE2)
+#  include <emmintrin.h>
+#endif
+
+QT_BEGIN_NAMESPACE
+
+// Number of offsets where the value can start: all of them must leave
+// enough room for the whole value in the data.
+static inline int startCount(int dataSize, int rangeStart, int rangeLength, int valueLength)
+{
+    return qMin(rangeLength, dataSize - rangeStart - valueLength + 1);
+}
+
+static inline bool maskedEqual(const char *d, const char *valueData, const char *mask, int valueLength)
+{
+    for (int idx = 0; idx < valueLength; ++idx) {
+        if ((d[idx] & mask[idx]) != (valueData[idx] & mask[idx]))
+            return false;
+    }
+    return true;
+}
+
+static bool matchSubstringScalar(const char *dataPtr, int dataSize, int rangeStart, int rangeLength,
+                                 int valueLength, const char *valueData, const char *mask)
+{
+    const char *readDataBase = dataPtr + rangeStart;
+    const int count = startCount(dataSize, rangeStart, rangeLength, valueLength);
+    if (!mask) {
+        // callgrind says QByteArray::indexOf is much slower, since our strings are typically too
+        // short for be worth Boyer-Moore matching (1 to 71 bytes, 11 bytes on average).
+        for (int i = 0; i < count; ++i) {
+            if (memcmp(valueData, readDataBase + i, valueLength) == 0)
+                return true;
+        }
+    } else {
+        for (int i = 0; i < count; ++i) {
+            if (maskedEqual(readDataBase + i, valueData, mask, valueLength))
+                return true;
+        }
+    }
+    return false;
+}
+
+// The vector kernels compare the first and the last byte of the value at 16 or 32
+// consecutive offsets at once, and only check the whole value where both are equal.
+// They only read bytes which the scalar loop would read too.
+
+#if defined(QMIME_HAVE_SSE2)
+static bool matchSubstringSse2(const char *dataPtr, int dataSize, int rangeStart, int rangeLength,
+                               int valueLength, const char *valueData, const char *mask)
+{
+    if (valueLength < 1)
+        return matchSubstringScalar(dataPtr, dataSize, rangeStart, rangeLength, valueLength, valueData, mask);
+
+    const char *readDataBase = dataPtr + rangeStart;
+    const int count = startCount(dataSize, rangeStart, rangeLength, valueLength);
+    const int last = valueLength - 1;
+    const char firstMask = mask ? mask[0] : char(0xff);
+    const char lastMask = mask ? mask[last] : char(0xff);
+    const __m128i firstMaskV = _mm_set1_epi8(firstMask);
+    const __m128i lastMaskV = _mm_set1_epi8(lastMask);
+    const __m128i firstV = _mm_set1_epi8(char(valueData[0] & firstMask));
+    const __m128i lastV = _mm_set1_epi8(char(valueData[last] & lastMask));
+
+    int i = 0;
+    for ( ; i + 16 <= count; i += 16) {
+        const __m128i firstData = _mm_loadu_si128(reinterpret_cast<const __m128i *>(readDataBase + i));
+        const __m128i lastData = _mm_loadu_si128(reinterpret_cast<const __m128i *>(readDataBase + i + last));
+        const __m128i eq = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(firstData, firstMaskV), firstV),
+                                         _mm_cmpeq_epi8(_mm_and_si128(lastData, lastMaskV), lastV));
+        unsigned bits = _mm_movemask_epi8(eq);
+        while (bits) {
+            const int bit = __builtin_ctz(bits);
+            const char *d = readDataBase + i + bit;
+            if (mask ? maskedEqual(d, valueData, mask, valueLength) : memcmp(d, valueData, valueLength) == 0)
+                return true;
+            bits &= bits - 1;
+        }
+    }
+    if (i >= count)
+        return false;
+    return matchSubstringScalar(dataPtr, dataSize, rangeStart + i, count - i, valueLength, valueData, mask);
+}
+#endif
+
+#if defined(QMIME_HAVE_AVX2)
+__attribute__((target("avx2")))
+static bool matchSubstringAvx2(const char *dataPtr, int dataSize, int rangeStart, int rangeLength,
+                               int valueLength, const char *valueData, const char *mask)
+{
+    if (valueLength < 1)
+        return matchSubstringScalar(dataPtr, dataSize, rangeStart, rangeLength, valueLength, valueData, mask);
+
+    const char *readDataBase = dataPtr + rangeStart;
+    const int count = startCount(dataSize, rangeStart, rangeLength, valueLength);
+    if (count < 32)
+        return matchSubstringSse2(dataPtr, dataSize, rangeStart, rangeLength, valueLength, valueData, mask);
+    const int last = valueLength - 1;
+    const char firstMask = mask ? mask[0] : char(0xff);
+    const char lastMask = mask ? mask[last] : char(0xff);
+    const __m256i firstMaskV = _mm256_set1_epi8(firstMask);
+    const __m256i lastMaskV = _mm256_set1_epi8(lastMask);
+    const __m256i firstV = _mm256_set1_epi8(char(valueData[0] & firstMask));
+    const __m256i lastV = _mm256_set1_epi8(char(valueData[last] & lastMask));
+
+    int i = 0;
+    for ( ; i + 32 <= count; i += 32) {
+        const __m256i firstData = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(readDataBase + i));
+        const __m256i lastData = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(readDataBase + i + last));
+        const __m256i eq = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(firstData, firstMaskV), firstV),
+                                            _mm256_cmpeq_epi8(_mm256_and_si256(lastData, lastMaskV), lastV));
+        unsigned bits = _mm256_movemask_epi8(eq);
+        while (bits) {
+            const int bit = __builtin_ctz(bits);
+            const char *d = readDataBase + i + bit;
+            if (mask ? maskedEqual(d, valueData, mask, valueLength) : memcmp(d, valueData, valueLength) == 0)
+                return true;
+            bits &= bits - 1;
+        }
+    }
+    if (i >= count)
+        return false;
+    return matchSubstringSse2(dataPtr, dataSize, rangeStart + i, count - i, valueLength, valueData, mask);
+}
+#endif
+
+QMimeMagicSubstringMatcher qmime_substringMatcher(QMimeMagicSubstringKernel kernel)
+{
+    switch (kernel) {
+    case QMimeMagicScalarKernel:
+        return matchSubstringScalar;
+    case QMimeMagicSse2Kernel:
+#if defined(QMIME_HAVE_SSE2)
+        return matchSubstringSse2;
+#else
+        return 0;
+#endif
+    case QMimeMagicAvx2Kernel:
+#if defined(QMIME_HAVE_AVX2)
+        if (__builtin_cpu_supports("avx2"))
+            return matchSubstringAvx2;
+#endif
+        return 0;
+    }
+    return 0;
+}
+
+static QMimeMagicSubstringMatcher findBestSubstringMatcher()
+{
+    QMimeMagicSubstringMatcher matcher = qmime_substringMatcher(QMimeMagicAvx2Kernel);
+    if (!matcher)
+        matcher = qmime_substringMatcher(QMimeMagicSse2Kernel);
+    if (!matcher)
+        matcher = qmime_substringMatcher(QMimeMagicScalarKernel);
+    return matcher;
+}
+
+QMimeMagicSubstringMatcher qmime_bestSubstringMatcher()
+{
+    static const QMimeMagicSubstringMatcher matcher = findBestSubstringMatcher();
+    return matcher;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,66 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtCore module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QMIMEMAGICSUBSTRING_P_H
+#define QMIMEMAGICSUBSTRING_P_H
+
+#include <QtCore/qglobal.h>
+
+QT_BEGIN_NAMESPACE
+
+// Returns true if the value, compared under the mask if any, starts in the data
+// at one of the offsets from rangeStart to rangeStart + rangeLength - 1.
+typedef bool (*QMimeMagicSubstringMatcher)(const char *dataPtr, int dataSize, int rangeStart, int rangeLength,
+                                           int valueLength, const char *valueData, const char *mask);
+
+enum QMimeMagicSubstringKernel {
+    QMimeMagicScalarKernel,
+    QMimeMagicSse2Kernel,
+    QMimeMagicAvx2Kernel
+};
+
+// Returns 0 if the kernel isn't supported by the compiler or the CPU
+QMimeMagicSubstringMatcher qmime_substringMatcher(QMimeMagicSubstringKernel kernel);
+QMimeMagicSubstringMatcher qmime_bestSubstringMatcher();
+
+QT_END_NAMESPACE
+
+#endif // QMIMEMAGICSUBSTRING_P_H
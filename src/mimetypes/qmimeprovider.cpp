@@ -39,8 +39,11 @@
 **
 ****************************************************************************/
 
+#include <qplatformdefs.h> // always first
+
 #include "qmimeprovider_p.h"
 
+#include "qmimecachewriter_p.h"
 #include "qmimetypeparser_p.h"
 #include <qstandardpaths.h>
 #include "qmimemagicrulematcher_p.h"
@@ -49,9 +52,16 @@
 #include <QDir>
 #include <QFile>
 #include <QByteArrayMatcher>
+#include <QBuffer>
+#include <QDataStream>
 #include <QDebug>
 #include <QDateTime>
 #include <QtEndian>
+#include <QResource>
+#include <QTemporaryFile>
+#include <QStack>
+#include <QVector>
+#include <QtConcurrentMap>
 
 QT_BEGIN_NAMESPACE
 
@@ -72,29 +82,181 @@ static QString fallbackParent(const QString &mimeTypeName)
 }
 
 QMimeProviderBase::QMimeProviderBase(QMimeDatabasePrivate *db)
-    : m_db(db)
+    : m_db(db), m_refCount(1), m_knownTypeCount(0)
 {
 }
 
-QMIME_EXPORT int qmime_secondsBetweenChecks = 5; // exported for the unit test
+/*!
+    \internal
+    Returns true if \a mime is \a parent or one of its descendants, \a parent being
+    possibly an alias. For the types of the provider, this is a single bit test.
+ */
+bool QMimeProviderBase::inherits(const QString &mime, const QString &parent)
+{
+    QString resolvedParent = parent;
+    int parentId = m_typeIds.value(parent, -1);
+    if (parentId == -1 || parentId >= m_knownTypeCount) {
+        resolvedParent = resolveAlias(parent);
+        parentId = m_typeIds.value(resolvedParent, -1);
+    }
+
+    const int mimeId = m_typeIds.value(mime, -1);
+    if (mimeId != -1)
+        return parentId != -1 && m_ancestors.at(mimeId).testBit(parentId);
+
+    // Not a type of the provider: walk up to the ones which are
+    QStack<QString> toCheck;
+    toCheck.push(mime);
+    while (!toCheck.isEmpty()) {
+        const QString current = toCheck.pop();
+        if (current == resolvedParent)
+            return true;
+        const int currentId = m_typeIds.value(current, -1);
+        if (currentId != -1) {
+            if (parentId != -1 && m_ancestors.at(currentId).testBit(parentId))
+                return true;
+            continue;
+        }
+        foreach (const QString &par, parents(current))
+            toCheck.push(par);
+    }
+    return false;
+}
 
-bool QMimeProviderBase::shouldCheck()
+static void collectParentMimeTypes(QMimeProviderBase *provider, const QString &mime, QStringList &allParents)
 {
-    const QDateTime now = QDateTime::currentDateTime();
-    if (m_lastCheck.isValid() && m_lastCheck.secsTo(now) < qmime_secondsBetweenChecks)
-        return false;
-    m_lastCheck = now;
-    return true;
+    QStringList parents = provider->parents(mime);
+    foreach (const QString &parent, parents) {
+        // I would use QSet, but since order matters I better not
+        if (!allParents.contains(parent))
+            allParents.append(parent);
+    }
+    // We want a breadth-first search, so that the least-specific parent (octet-stream) is last
+    // This means iterating twice, unfortunately.
+    foreach (const QString &parent, parents) {
+        collectParentMimeTypes(provider, parent, allParents);
+    }
 }
 
-QMimeBinaryProvider::QMimeBinaryProvider(QMimeDatabasePrivate *db)
-    : QMimeProviderBase(db), m_mimetypeListLoaded(false)
+/*!
+    \internal
+    Returns the ancestors of \a mime, least specific last, as computed when the
+    provider was loaded.
+ */
+QStringList QMimeProviderBase::allAncestors(const QString &mime)
 {
+    const int mimeId = m_typeIds.value(mime, -1);
+    if (mimeId != -1)
+        return m_allAncestors.at(mimeId);
+
+    QStringList allParents;
+    collectParentMimeTypes(this, mime, allParents);
+    return allParents;
 }
 
-#if defined(Q_OS_UNIX) && !defined(Q_OS_INTEGRITY)
-#define QT_USE_MMAP
-#endif
+// Same order as collectParentMimeTypes(), in linear time: a type expanded once
+// can't add anything new when reached again
+static void collectAncestorIds(int id, const QVector<QVector<int> > &parentIds, QVector<int> &result, QBitArray &seen, QBitArray &expanded)
+{
+    if (expanded.testBit(id))
+        return;
+    expanded.setBit(id);
+    const QVector<int> &parents = parentIds.at(id);
+    foreach (int parentId, parents) {
+        if (!seen.testBit(parentId)) {
+            seen.setBit(parentId);
+            result.append(parentId);
+        }
+    }
+    foreach (int parentId, parents)
+        collectAncestorIds(parentId, parentIds, result, seen, expanded);
+}
+
+static void closeAncestors(int id, const QVector<QVector<int> > &parentIds, QVector<QBitArray> &ancestors, QBitArray &visiting)
+{
+    if (!ancestors.at(id).isEmpty() || visiting.testBit(id))
+        return; // already done, or a cycle in the hierarchy
+    visiting.setBit(id);
+    QBitArray bits(parentIds.size());
+    bits.setBit(id);
+    foreach (int parentId, parentIds.at(id)) {
+        closeAncestors(parentId, parentIds, ancestors, visiting);
+        if (ancestors.at(parentId).isEmpty())
+            bits.setBit(parentId); // still being computed, in a cycle
+        else
+            bits |= ancestors.at(parentId);
+    }
+    ancestors[id] = bits;
+    visiting.clearBit(id);
+}
+
+/*!
+    \internal
+    Numbers \a mimeTypeNames and the names found in their parents(), including
+    the fallback parents, and computes the ancestors of each of them, for inherits().
+    Called by the providers once they are loaded.
+ */
+void QMimeProviderBase::buildAncestorClosure(const QStringList &mimeTypeNames)
+{
+    m_typeIds.clear();
+    QStringList names = mimeTypeNames;
+    for (int id = 0; id < names.count(); ++id)
+        m_typeIds.insert(names.at(id), id);
+    m_knownTypeCount = names.count();
+
+    QVector<QVector<int> > parentIds;
+    for (int id = 0; id < names.count(); ++id) { // names grows with new parents
+        QVector<int> ids;
+        foreach (const QString &parent, parents(names.at(id))) {
+            QHash<QString, int>::const_iterator it = m_typeIds.constFind(parent);
+            if (it == m_typeIds.constEnd()) {
+                ids.append(names.count());
+                m_typeIds.insert(parent, names.count());
+                names.append(parent);
+            } else {
+                ids.append(it.value());
+            }
+        }
+        parentIds.append(ids);
+    }
+
+    m_ancestors = QVector<QBitArray>(names.count());
+    QBitArray visiting(names.count());
+    for (int id = 0; id < names.count(); ++id)
+        closeAncestors(id, parentIds, m_ancestors, visiting);
+
+    m_allAncestors = QVector<QStringList>(names.count());
+    QVector<int> ancestorIds;
+    QBitArray seen(names.count());
+    QBitArray expanded(names.count());
+    for (int id = 0; id < names.count(); ++id) {
+        ancestorIds.clear();
+        seen.fill(false);
+        expanded.fill(false);
+        collectAncestorIds(id, parentIds, ancestorIds, seen, expanded);
+        QStringList &allParents = m_allAncestors[id];
+        foreach (int ancestorId, ancestorIds)
+            allParents.append(names.at(ancestorId));
+    }
+}
+
+QMimeBinaryProvider::QMimeBinaryProvider(QMimeDatabasePrivate *db, const QString &mimeDir)
+    : QMimeProviderBase(db), m_mimeDir(mimeDir)
+{
+}
+
+// Position of the "list offsets" values, at the beginning of the mime.cache file
+enum {
+    PosAliasListOffset = 4,
+    PosParentListOffset = 8,
+    PosLiteralListOffset = 12,
+    PosReverseSuffixTreeOffset = 16,
+    PosGlobListOffset = 20,
+    PosMagicListOffset = 24,
+    // PosNamespaceListOffset = 28,
+    PosIconsListOffset = 32,
+    PosGenericIconsListOffset = 36
+};
 
 struct QMimeBinaryProvider::CacheFile
 {
@@ -115,12 +277,27 @@ struct QMimeBinaryProvider::CacheFile
         return reinterpret_cast<const char *>(data + offset);
     }
     bool load();
-    bool reload();
 
     QFile file;
     uchar *data;
     QDateTime m_mtime;
     bool m_valid;
+
+    // Values of the unmasked ranged matchlets, by matchlet offset
+    QMimeMagicStringScanner magicScanner;
+    QHash<int, int> magicScanPatterns;
+    QMimeMagicDispatchIndex magicIndex;
+    QVector<int> magicExtents; // number of bytes needed by each match
+    QMimeGlobLiteralTable literalGlobs;
+    QMimeGlobPatternList globs;
+
+private:
+    void buildGlobs();
+    void buildMagicIndexes();
+    void indexMagicMatch(int match, int numMatchlets, int firstOffset);
+    void addMagicMatchlets(int numMatchlets, int firstOffset);
+    int magicMatchletsExtent(int numMatchlets, int firstOffset) const;
+    QMimeGlobPattern globAt(int off, int index) const;
 };
 
 QMimeBinaryProvider::CacheFile::CacheFile(const QString &fileName)
@@ -144,27 +321,107 @@ bool QMimeBinaryProvider::CacheFile::load()
         m_valid = (major == 1 && minor >= 1 && minor <= 2);
     }
     m_mtime = QFileInfo(file).lastModified();
+    if (m_valid) {
+        buildMagicIndexes();
+        buildGlobs();
+    }
     return m_valid;
 }
 
-bool QMimeBinaryProvider::CacheFile::reload()
+/*!
+    \internal
+    Reads the glob at \a index of the literal or glob list starting at \a off.
+*/
+QMimeGlobPattern QMimeBinaryProvider::CacheFile::globAt(int off, int index) const
 {
-    //qDebug() << "reload!" << file->fileName();
-    m_valid = false;
-    if (file.isOpen()) {
-        file.close();
+    const int globOffset = getUint32(off + 4 + 12 * index);
+    const int mimeTypeOffset = getUint32(off + 4 + 12 * index + 4);
+    const int flagsAndWeight = getUint32(off + 4 + 12 * index + 8);
+    const int weight = flagsAndWeight & 0xff;
+    const bool caseSensitive = flagsAndWeight & 0x100;
+    return QMimeGlobPattern(QLatin1String(getCharStar(globOffset)), QLatin1String(getCharStar(mimeTypeOffset)),
+                            weight, caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
+}
+
+/*!
+    \internal
+    Compiles the literal and glob lists once per load, rather than on each lookup:
+    the literals are hashed by name, the globs are classified and precompiled.
+*/
+void QMimeBinaryProvider::CacheFile::buildGlobs()
+{
+    const int literalListOffset = getUint32(PosLiteralListOffset);
+    const int numLiterals = getUint32(literalListOffset);
+    for (int i = 0; i < numLiterals; ++i)
+        literalGlobs.addGlob(globAt(literalListOffset, i));
+
+    const int globListOffset = getUint32(PosGlobListOffset);
+    const int numGlobs = getUint32(globListOffset);
+    for (int i = 0; i < numGlobs; ++i)
+        globs.append(globAt(globListOffset, i));
+}
+
+void QMimeBinaryProvider::CacheFile::buildMagicIndexes()
+{
+    const int magicListOffset = getUint32(PosMagicListOffset);
+    const int numMatches = getUint32(magicListOffset);
+    const int firstMatchOffset = getUint32(magicListOffset + 8);
+    for (int i = 0; i < numMatches; ++i) {
+        const int off = firstMatchOffset + i * 16;
+        indexMagicMatch(i, getUint32(off + 8), getUint32(off + 12));
+        addMagicMatchlets(getUint32(off + 8), getUint32(off + 12));
+        magicExtents.append(magicMatchletsExtent(getUint32(off + 8), getUint32(off + 12)));
     }
-    data = 0;
-    return load();
+    magicScanner.build();
+    magicIndex.build(numMatches);
 }
 
-QMimeBinaryProvider::CacheFile *QMimeBinaryProvider::CacheFileList::findCacheFile(const QString &fileName) const
+void QMimeBinaryProvider::CacheFile::indexMagicMatch(int match, int numMatchlets, int firstOffset)
 {
-    for (const_iterator it = begin(); it != end(); ++it) {
-        if ((*it)->file.fileName() == fileName)
-            return *it;
+    for (int matchlet = 0; matchlet < numMatchlets; ++matchlet) {
+        const int off = firstOffset + matchlet * 32;
+        const int rangeLength = getUint32(off + 4);
+        const int valueLength = getUint32(off + 12);
+        const int maskOffset = getUint32(off + 20);
+        if (valueLength > 0 && (rangeLength != 1 || (maskOffset && uchar(*getCharStar(maskOffset)) != 0xff))) {
+            magicIndex.addUnindexedMatcher(match);
+            return;
+        }
+    }
+    for (int matchlet = 0; matchlet < numMatchlets; ++matchlet) {
+        const int off = firstOffset + matchlet * 32;
+        if (getUint32(off + 12) > 0)
+            magicIndex.addKey(match, getUint32(off), *getCharStar(getUint32(off + 16)));
+    }
+}
+
+int QMimeBinaryProvider::CacheFile::magicMatchletsExtent(int numMatchlets, int firstOffset) const
+{
+    int extent = 0;
+    for (int matchlet = 0; matchlet < numMatchlets; ++matchlet) {
+        const int off = firstOffset + matchlet * 32;
+        const int valueLength = getUint32(off + 12);
+        if (valueLength > 0)
+            extent = qMax(extent, int(getUint32(off) + getUint32(off + 4)) - 1 + valueLength);
+        extent = qMax(extent, magicMatchletsExtent(getUint32(off + 24), getUint32(off + 28)));
+    }
+    return extent;
+}
+
+void QMimeBinaryProvider::CacheFile::addMagicMatchlets(int numMatchlets, int firstOffset)
+{
+    for (int matchlet = 0; matchlet < numMatchlets; ++matchlet) {
+        const int off = firstOffset + matchlet * 32;
+        const int rangeStart = getUint32(off);
+        const int rangeLength = getUint32(off + 4);
+        const int valueLength = getUint32(off + 12);
+        const int maskOffset = getUint32(off + 20);
+        if (rangeLength > 1 && valueLength > 0 && !maskOffset) {
+            const QByteArray value(getCharStar(getUint32(off + 16)), valueLength);
+            magicScanPatterns.insert(off, magicScanner.addPattern(value, rangeStart + rangeLength - 1));
+        }
+        addMagicMatchlets(getUint32(off + 24), getUint32(off + 28));
     }
-    return 0;
 }
 
 QMimeBinaryProvider::~QMimeBinaryProvider()
@@ -172,18 +429,6 @@ QMimeBinaryProvider::~QMimeBinaryProvider()
     qDeleteAll(m_cacheFiles);
 }
 
-// Position of the "list offsets" values, at the beginning of the mime.cache file
-enum {
-    PosAliasListOffset = 4,
-    PosParentListOffset = 8,
-    PosLiteralListOffset = 12,
-    PosReverseSuffixTreeOffset = 16,
-    PosGlobListOffset = 20,
-    PosMagicListOffset = 24,
-    // PosNamespaceListOffset = 28,
-    PosIconsListOffset = 32,
-    PosGenericIconsListOffset = 36
-};
 
 bool QMimeBinaryProvider::isValid()
 {
@@ -192,7 +437,7 @@ bool QMimeBinaryProvider::isValid()
         return false;
 
     Q_ASSERT(m_cacheFiles.isEmpty()); // this method is only ever called once
-    checkCache();
+    loadCacheFiles();
 
     if (m_cacheFiles.count() > 1)
         return true;
@@ -209,57 +454,46 @@ bool QMimeBinaryProvider::isValid()
 #endif
 }
 
-bool QMimeBinaryProvider::CacheFileList::checkCacheChanged()
+// Returns the files named \a fileName of the mime directories, the local one first
+QStringList QMimeBinaryProvider::mimeFiles(const QString &fileName) const
+{
+    if (m_mimeDir.isEmpty())
+        return QStandardPaths::locateAll(QStandardPaths::GenericDataLocation, QLatin1String("mime/") + fileName);
+    const QString path = m_mimeDir + QLatin1Char('/') + fileName;
+    return QFileInfo(path).exists() ? QStringList(path) : QStringList();
+}
+
+void QMimeBinaryProvider::loadCacheFiles()
 {
-    bool somethingChanged = false;
-    QMutableListIterator<CacheFile *> it(*this);
-    while (it.hasNext()) {
-        CacheFile *cacheFile = it.next();
-        QFileInfo fileInfo(cacheFile->file);
-        if (!fileInfo.exists()) { // This can't happen by just running update-mime-database. But the user could use rm -rf :-)
+    m_cacheFileNames = mimeFiles(QLatin1String("mime.cache"));
+    foreach (const QString &cacheFileName, m_cacheFileNames) {
+        CacheFile *cacheFile = new CacheFile(cacheFileName);
+        if (cacheFile->isValid()) // verify version
+            m_cacheFiles.append(cacheFile);
+        else
             delete cacheFile;
-            it.remove();
-            somethingChanged = true;
-        } else if (fileInfo.lastModified() > cacheFile->m_mtime) {
-            if (!cacheFile->reload()) {
-                delete cacheFile;
-                it.remove();
-            }
-            somethingChanged = true;
-        }
     }
-    return somethingChanged;
 }
 
-void QMimeBinaryProvider::checkCache()
+void QMimeBinaryProvider::ensureLoaded()
 {
-    if (!shouldCheck())
-        return;
+    loadMimeTypeList();
+    buildAncestorClosure(m_mimeTypes.keys());
+}
 
-    // First iterate over existing known cache files and check for uptodate
-    if (m_cacheFiles.checkCacheChanged())
-        m_mimetypeListLoaded = false;
-
-    // Then check if new cache files appeared
-    const QStringList cacheFileNames = QStandardPaths::locateAll(QStandardPaths::GenericDataLocation, QLatin1String("mime/mime.cache"));
-    if (cacheFileNames != m_cacheFileNames) {
-        foreach (const QString &cacheFileName, cacheFileNames) {
-            CacheFile *cacheFile = m_cacheFiles.findCacheFile(cacheFileName);
-            if (!cacheFile) {
-                //qDebug() << "new file:" << cacheFileName;
-                cacheFile = new CacheFile(cacheFileName);
-                if (cacheFile->isValid()) // verify version
-                    m_cacheFiles.append(cacheFile);
-                else
-                    delete cacheFile;
-            }
-        }
-        m_cacheFileNames = cacheFileNames;
-        m_mimetypeListLoaded = false;
+bool QMimeBinaryProvider::isUpToDate() const
+{
+    foreach (const CacheFile *cacheFile, m_cacheFiles) {
+        const QFileInfo fileInfo(cacheFile->file);
+        // Removing a file can't happen by just running update-mime-database. But the user could use rm -rf :-)
+        if (!fileInfo.exists() || fileInfo.lastModified() > cacheFile->m_mtime)
+            return false;
     }
+    // Check if new cache files appeared
+    return mimeFiles(QLatin1String("mime.cache")) == m_cacheFileNames;
 }
 
-static QMimeType mimeTypeForNameUnchecked(const QString &name)
+static QMimeType createMimeType(const QString &name)
 {
     QMimeTypePrivate data;
     data.name = name;
@@ -270,64 +504,60 @@ static QMimeType mimeTypeForNameUnchecked(const QString &name)
     return QMimeType(data);
 }
 
+QMimeType QMimeBinaryProvider::mimeTypeForNameUnchecked(const QString &name) const
+{
+    QHash<QString, QMimeType>::const_iterator it = m_mimeTypes.constFind(name);
+    if (it != m_mimeTypes.constEnd())
+        return it.value();
+    return createMimeType(name); // not listed in the "types" files
+}
+
 QMimeType QMimeBinaryProvider::mimeTypeForName(const QString &name)
 {
-    checkCache();
-    if (!m_mimetypeListLoaded)
-        loadMimeTypeList();
-    if (!m_mimetypeNames.contains(name))
-        return QMimeType(); // unknown mimetype
-    return mimeTypeForNameUnchecked(name);
+    return m_mimeTypes.value(name); // invalid for an unknown mimetype
 }
 
-QStringList QMimeBinaryProvider::findByFileName(const QString &fileName, QString *foundSuffix)
+QStringList QMimeBinaryProvider::findByFileName(const QMimeGlobLookupContext &context, QString *foundSuffix)
 {
-    checkCache();
+    const QString &fileName = context.fileName();
     if (fileName.isEmpty())
         return QStringList();
-    const QString lowerFileName = fileName.toLower();
     QMimeGlobMatchResult result;
     // TODO this parses in the order (local, global). Check that it handles "NOGLOBS" correctly.
     foreach (CacheFile *cacheFile, m_cacheFiles) {
-        matchGlobList(result, cacheFile, cacheFile->getUint32(PosLiteralListOffset), fileName);
-        matchGlobList(result, cacheFile, cacheFile->getUint32(PosGlobListOffset), fileName);
+        cacheFile->literalGlobs.match(result, context);
+        cacheFile->globs.match(result, context);
         const int reverseSuffixTreeOffset = cacheFile->getUint32(PosReverseSuffixTreeOffset);
         const int numRoots = cacheFile->getUint32(reverseSuffixTreeOffset);
         const int firstRootOffset = cacheFile->getUint32(reverseSuffixTreeOffset + 4);
-        matchSuffixTree(result, cacheFile, numRoots, firstRootOffset, lowerFileName, fileName.length() - 1, false);
+        QMimeGlobMatchResult exactResult;
+        matchSuffixTree(result, exactResult, cacheFile, numRoots, firstRootOffset, context, fileName.length() - 1, FoldedAndExactWalk);
+        // Case-sensitive globs only count when nothing else matched
         if (result.m_matchingMimeTypes.isEmpty())
-            matchSuffixTree(result, cacheFile, numRoots, firstRootOffset, fileName, fileName.length() - 1, true);
+            result = exactResult;
     }
     if (foundSuffix)
         *foundSuffix = result.m_foundSuffix;
     return result.m_matchingMimeTypes;
 }
 
-void QMimeBinaryProvider::matchGlobList(QMimeGlobMatchResult &result, CacheFile *cacheFile, int off, const QString &fileName)
+/*!
+    \internal
+    Walks the reverse suffix tree once for both the lowercased and the exact file name:
+    the two walks only split at the characters where they differ. Case-insensitive globs
+    are stored lowercased, so they are only accepted on the folded walk, into \a result,
+    while case-sensitive globs are only accepted on the exact one, into \a exactResult.
+    Each walk prefers its own longest match, as if they had been done one after the other.
+    Returns the SuffixTreeMatch flags of the walks that matched.
+*/
+int QMimeBinaryProvider::matchSuffixTree(QMimeGlobMatchResult &result, QMimeGlobMatchResult &exactResult, QMimeBinaryProvider::CacheFile *cacheFile, int numEntries, int firstOffset, const QMimeGlobLookupContext &context, int charPos, SuffixTreeWalk walk)
 {
-    const int numGlobs = cacheFile->getUint32(off);
-    //qDebug() << "Loading" << numGlobs << "globs from" << cacheFile->file.fileName() << "at offset" << cacheFile->globListOffset;
-    for (int i = 0; i < numGlobs; ++i) {
-        const int globOffset = cacheFile->getUint32(off + 4 + 12 * i);
-        const int mimeTypeOffset = cacheFile->getUint32(off + 4 + 12 * i + 4);
-        const int flagsAndWeight = cacheFile->getUint32(off + 4 + 12 * i + 8);
-        const int weight = flagsAndWeight & 0xff;
-        const bool caseSensitive = flagsAndWeight & 0x100;
-        const Qt::CaseSensitivity qtCaseSensitive = caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
-        const QString pattern = QLatin1String(cacheFile->getCharStar(globOffset));
-
-        const char *mimeType = cacheFile->getCharStar(mimeTypeOffset);
-        //qDebug() << pattern << mimeType << weight << caseSensitive;
-        QMimeGlobPattern glob(pattern, QString() /*unused*/, weight, qtCaseSensitive);
-
-        // TODO: this could be done faster for literals where a simple == would do.
-        if (glob.matchFileName(fileName))
-            result.addMatch(QLatin1String(mimeType), weight, pattern);
+    const QString &fileName = walk == ExactWalk ? context.fileName() : context.lowerFileName();
+    if (walk == FoldedAndExactWalk && context.fileName().at(charPos) != fileName.at(charPos)) {
+        return matchSuffixTree(result, exactResult, cacheFile, numEntries, firstOffset, context, charPos, FoldedWalk)
+             | matchSuffixTree(result, exactResult, cacheFile, numEntries, firstOffset, context, charPos, ExactWalk);
     }
-}
 
-bool QMimeBinaryProvider::matchSuffixTree(QMimeGlobMatchResult &result, QMimeBinaryProvider::CacheFile *cacheFile, int numEntries, int firstOffset, const QString &fileName, int charPos, bool caseSensitiveCheck)
-{
     QChar fileChar = fileName[charPos];
     int min = 0;
     int max = numEntries - 1;
@@ -343,36 +573,36 @@ bool QMimeBinaryProvider::matchSuffixTree(QMimeGlobMatchResult &result, QMimeBin
             --charPos;
             int numChildren = cacheFile->getUint32(off + 4);
             int childrenOffset = cacheFile->getUint32(off + 8);
-            bool success = false;
+            int found = NoSuffixMatch;
             if (charPos > 0)
-                success = matchSuffixTree(result, cacheFile, numChildren, childrenOffset, fileName, charPos, caseSensitiveCheck);
-            if (!success) {
-                for (int i = 0; i < numChildren; ++i) {
-                    const int childOff = childrenOffset + 12 * i;
-                    const int mch = cacheFile->getUint32(childOff);
-                    if (mch != 0)
-                        break;
-                    const int mimeTypeOffset = cacheFile->getUint32(childOff + 4);
-                    const char *mimeType = cacheFile->getCharStar(mimeTypeOffset);
-                    const int flagsAndWeight = cacheFile->getUint32(childOff + 8);
-                    const int weight = flagsAndWeight & 0xff;
-                    const bool caseSensitive = flagsAndWeight & 0x100;
-                    if (caseSensitiveCheck || !caseSensitive) {
-                        result.addMatch(QLatin1String(mimeType), weight, QLatin1Char('*') + fileName.mid(charPos+1));
-                        success = true;
-                    }
-                }
+                found = matchSuffixTree(result, exactResult, cacheFile, numChildren, childrenOffset, context, charPos, walk);
+            // Only the walks that didn't match a longer suffix look at the leaves here
+            int foundHere = NoSuffixMatch;
+            for (int i = 0; i < numChildren; ++i) {
+                const int childOff = childrenOffset + 12 * i;
+                const int mch = cacheFile->getUint32(childOff);
+                if (mch != 0)
+                    break;
+                const int flagsAndWeight = cacheFile->getUint32(childOff + 8);
+                const bool caseSensitive = flagsAndWeight & 0x100;
+                const SuffixTreeMatch match = caseSensitive ? ExactSuffixMatch : FoldedSuffixMatch;
+                if ((caseSensitive ? walk == FoldedWalk : walk == ExactWalk) || (found & match))
+                    continue;
+                const int mimeTypeOffset = cacheFile->getUint32(childOff + 4);
+                const char *mimeType = cacheFile->getCharStar(mimeTypeOffset);
+                const int weight = flagsAndWeight & 0xff;
+                QMimeGlobMatchResult &matchResult = caseSensitive ? exactResult : result;
+                matchResult.addMatch(QLatin1String(mimeType), weight, QLatin1Char('*') + fileName.mid(charPos+1));
+                foundHere |= match;
             }
-            return success;
+            return found | foundHere;
         }
     }
-    return false;
+    return NoSuffixMatch;
 }
 
-bool QMimeBinaryProvider::matchMagicRule(QMimeBinaryProvider::CacheFile *cacheFile, int numMatchlets, int firstOffset, const QByteArray &data)
+bool QMimeBinaryProvider::matchMagicRule(QMimeBinaryProvider::CacheFile *cacheFile, int numMatchlets, int firstOffset, const char *dataPtr, int dataSize, QMimeMagicStringScanner::Result *scanResult, QMimeMagicLookupStats *stats)
 {
-    const char *dataPtr = data.constData();
-    const int dataSize = data.size();
     for (int matchlet = 0; matchlet < numMatchlets; ++matchlet) {
         const int off = firstOffset + matchlet * 32;
         const int rangeStart = cacheFile->getUint32(off);
@@ -382,35 +612,56 @@ bool QMimeBinaryProvider::matchMagicRule(QMimeBinaryProvider::CacheFile *cacheFi
         const int valueOffset = cacheFile->getUint32(off + 16);
         const int maskOffset = cacheFile->getUint32(off + 20);
         const char *mask = maskOffset ? cacheFile->getCharStar(maskOffset) : NULL;
-
-        if (!QMimeMagicRule::matchSubstring(dataPtr, dataSize, rangeStart, rangeLength, valueLength, cacheFile->getCharStar(valueOffset), mask))
+        if (stats)
+            ++stats->rulesEvaluated;
+
+        const int scanPattern = (rangeLength > 1 && !mask) ? cacheFile->magicScanPatterns.value(off, -1) : -1;
+        if (scanPattern != -1) {
+            if (!scanResult->scanned)
+                cacheFile->magicScanner.scan(dataPtr, dataSize, scanResult);
+            if (!scanResult->contains(scanPattern, rangeStart, rangeLength))
+                continue;
+        } else if (!QMimeMagicRule::matchSubstring(dataPtr, dataSize, rangeStart, rangeLength, valueLength, cacheFile->getCharStar(valueOffset), mask)) {
             continue;
+        }
 
         const int numChildren = cacheFile->getUint32(off + 24);
         const int firstChildOffset = cacheFile->getUint32(off + 28);
         if (numChildren == 0) // No submatch? Then we are done.
             return true;
         // Check that one of the submatches matches too
-        if (matchMagicRule(cacheFile, numChildren, firstChildOffset, data))
+        if (matchMagicRule(cacheFile, numChildren, firstChildOffset, dataPtr, dataSize, scanResult, stats))
             return true;
     }
     return false;
 }
 
-QMimeType QMimeBinaryProvider::findByMagic(const QByteArray &data, int *accuracyPtr)
+QMimeType QMimeBinaryProvider::findByMagic(const char *data, int dataSize, int *accuracyPtr, QMimeMagicLookupStats *stats)
 {
-    checkCache();
+    if (stats) {
+        foreach (CacheFile *cacheFile, m_cacheFiles)
+            stats->matcherCount += cacheFile->getUint32(cacheFile->getUint32(PosMagicListOffset));
+    }
+
     foreach (CacheFile *cacheFile, m_cacheFiles) {
         const int magicListOffset = cacheFile->getUint32(PosMagicListOffset);
         const int numMatches = cacheFile->getUint32(magicListOffset);
-        //const int maxExtent = cacheFile->getUint32(magicListOffset + 4);
         const int firstMatchOffset = cacheFile->getUint32(magicListOffset + 8);
+        QMimeMagicStringScanner::Result scanResult;
+        const bool useIndex = (!stats || stats->useDispatchIndex) && cacheFile->magicIndex.isBuilt();
+        QBitArray candidates;
+        if (useIndex)
+            cacheFile->magicIndex.findCandidates(data, dataSize, &candidates);
 
         for (int i = 0; i < numMatches; ++i) {
+            if (useIndex && !candidates.testBit(i))
+                continue;
+            if (stats)
+                ++stats->matchersEvaluated;
             const int off = firstMatchOffset + i * 16;
             const int numMatchlets = cacheFile->getUint32(off + 8);
             const int firstMatchletOffset = cacheFile->getUint32(off + 12);
-            if (matchMagicRule(cacheFile, numMatchlets, firstMatchletOffset, data)) {
+            if (matchMagicRule(cacheFile, numMatchlets, firstMatchletOffset, data, dataSize, &scanResult, stats)) {
                 const int mimeTypeOffset = cacheFile->getUint32(off + 4);
                 const char *mimeType = cacheFile->getCharStar(mimeTypeOffset);
                 *accuracyPtr = cacheFile->getUint32(off);
@@ -423,9 +674,75 @@ QMimeType QMimeBinaryProvider::findByMagic(const QByteArray &data, int *accuracy
     return QMimeType();
 }
 
+// Like matchMagicRule(), but for data which may still be incomplete: a matchlet which didn't
+// match is only known to never match if all the bytes it looks at are available.
+QMimeBinaryProvider::MagicMatchState QMimeBinaryProvider::magicMatchState(CacheFile *cacheFile, int numMatchlets, int firstOffset, const char *dataPtr, int dataSize)
+{
+    MagicMatchState result = NoMagicMatch;
+    for (int matchlet = 0; matchlet < numMatchlets; ++matchlet) {
+        const int off = firstOffset + matchlet * 32;
+        const int rangeStart = cacheFile->getUint32(off);
+        const int rangeLength = cacheFile->getUint32(off + 4);
+        const int valueLength = cacheFile->getUint32(off + 12);
+        const int valueOffset = cacheFile->getUint32(off + 16);
+        const int maskOffset = cacheFile->getUint32(off + 20);
+        const char *mask = maskOffset ? cacheFile->getCharStar(maskOffset) : NULL;
+
+        MagicMatchState state;
+        if (QMimeMagicRule::matchSubstring(dataPtr, dataSize, rangeStart, rangeLength, valueLength, cacheFile->getCharStar(valueOffset), mask))
+            state = MagicMatch;
+        else
+            state = rangeStart + rangeLength - 1 + valueLength <= dataSize ? NoMagicMatch : MagicUndecided;
+
+        const int numChildren = cacheFile->getUint32(off + 24);
+        if (state != NoMagicMatch && numChildren) {
+            const MagicMatchState children = magicMatchState(cacheFile, numChildren, cacheFile->getUint32(off + 28), dataPtr, dataSize);
+            if (children != MagicMatch)
+                state = children;
+        }
+        if (state == MagicMatch)
+            return MagicMatch;
+        if (state == MagicUndecided)
+            result = MagicUndecided;
+    }
+    return result;
+}
+
+int QMimeBinaryProvider::magicDataNeeded(const char *data, int dataSize)
+{
+    // The first match wins, so only the undecided matches before it matter
+    int needed = 0;
+    foreach (CacheFile *cacheFile, m_cacheFiles) {
+        const int magicListOffset = cacheFile->getUint32(PosMagicListOffset);
+        const int numMatches = cacheFile->getUint32(magicListOffset);
+        const int firstMatchOffset = cacheFile->getUint32(magicListOffset + 8);
+        for (int i = 0; i < numMatches; ++i) {
+            const int off = firstMatchOffset + i * 16;
+            const int extent = cacheFile->magicExtents.value(i);
+            if (extent <= needed && extent <= dataSize)
+                continue; // cannot change the result
+            const MagicMatchState state = magicMatchState(cacheFile, cacheFile->getUint32(off + 8), cacheFile->getUint32(off + 12), data, dataSize);
+            if (state == MagicMatch)
+                return needed;
+            if (state == MagicUndecided)
+                needed = qMax(needed, extent);
+        }
+    }
+    return needed;
+}
+
+int QMimeBinaryProvider::magicMaxExtent()
+{
+    int maxExtent = 0;
+    foreach (CacheFile *cacheFile, m_cacheFiles) {
+        const int magicListOffset = cacheFile->getUint32(PosMagicListOffset);
+        maxExtent = qMax(maxExtent, int(cacheFile->getUint32(magicListOffset + 4)));
+    }
+    return maxExtent;
+}
+
 QStringList QMimeBinaryProvider::parents(const QString &mime)
 {
-    checkCache();
     const QByteArray mimeStr = mime.toLatin1();
     QStringList result;
     foreach (CacheFile *cacheFile, m_cacheFiles) {
@@ -466,7 +783,6 @@ QStringList QMimeBinaryProvider::parents(const QString &mime)
 
 QString QMimeBinaryProvider::resolveAlias(const QString &name)
 {
-    checkCache();
     const QByteArray input = name.toLatin1();
     foreach (CacheFile *cacheFile, m_cacheFiles) {
         const int aliasListOffset = cacheFile->getUint32(PosAliasListOffset);
@@ -496,20 +812,19 @@ QString QMimeBinaryProvider::resolveAlias(const QString &name)
 
 void QMimeBinaryProvider::loadMimeTypeList()
 {
-    if (!m_mimetypeListLoaded) {
-        m_mimetypeListLoaded = true;
-        m_mimetypeNames.clear();
-        // Unfortunately mime.cache doesn't have a full list of all mimetypes.
-        // So we have to parse the plain-text files called "types".
-        const QStringList typesFilenames = QStandardPaths::locateAll(QStandardPaths::GenericDataLocation, QLatin1String("mime/types"));
-        foreach (const QString &typeFilename, typesFilenames) {
-            QFile file(typeFilename);
-            if (file.open(QIODevice::ReadOnly)) {
-                while (!file.atEnd()) {
-                    QByteArray line = file.readLine();
-                    line.chop(1);
-                    m_mimetypeNames.insert(QString::fromLatin1(line.constData(), line.size()));
-                }
+    m_mimeTypes.clear();
+    // Unfortunately mime.cache doesn't have a full list of all mimetypes.
+    // So we have to parse the plain-text files called "types".
+    const QStringList typesFilenames = mimeFiles(QLatin1String("types"));
+    foreach (const QString &typeFilename, typesFilenames) {
+        QFile file(typeFilename);
+        if (file.open(QIODevice::ReadOnly)) {
+            while (!file.atEnd()) {
+                QByteArray line = file.readLine();
+                line.chop(1);
+                const QString name = QString::fromLatin1(line.constData(), line.size());
+                if (!m_mimeTypes.contains(name))
+                    m_mimeTypes.insert(name, createMimeType(name));
             }
         }
     }
@@ -517,26 +832,31 @@ void QMimeBinaryProvider::loadMimeTypeList()
 
 QList<QMimeType> QMimeBinaryProvider::allMimeTypes()
 {
-    QList<QMimeType> result;
-    loadMimeTypeList();
-
-    for (QSet<QString>::const_iterator it = m_mimetypeNames.constBegin();
-          it != m_mimetypeNames.constEnd(); ++it)
-        result.append(mimeTypeForNameUnchecked(*it));
-
-    return result;
+    return m_mimeTypes.values();
 }
 
+// Serializes filling in the QMimeTypePrivate instances. Not a member of the provider:
+// the instances outlive it, and during a reload two providers may fill in the same one.
+Q_GLOBAL_STATIC(QMutex, mimeTypeLoadMutex)
+
 void QMimeBinaryProvider::loadMimeTypePrivate(QMimeTypePrivate &data)
 {
-    if (data.loaded)
+    if (data.isLoaded(QMimeTypePrivate::DetailsLoaded))
         return;
-    data.loaded = true;
-    // load comment and globPatterns
+    QMutexLocker locker(mimeTypeLoadMutex());
+    if (!data.isLoaded(QMimeTypePrivate::DetailsLoaded)) {
+        loadMimeTypeXml(data);
+        data.setLoaded(QMimeTypePrivate::DetailsLoaded);
+    }
+}
+
+// Loads comment and globPatterns
+void QMimeBinaryProvider::loadMimeTypeXml(QMimeTypePrivate &data)
+{
 
     const QString file = data.name + QLatin1String(".xml");
-    const QStringList mimeFiles = QStandardPaths::locateAll(QStandardPaths::GenericDataLocation, QString::fromLatin1("mime/") + file);
-    if (mimeFiles.isEmpty()) {
+    const QStringList xmlFiles = mimeFiles(file);
+    if (xmlFiles.isEmpty()) {
         // TODO: ask Thiago about this
         qWarning() << "No file found for" << file << ", even though the file appeared in a directory listing.";
         qWarning() << "Either it was just removed, or the directory doesn't have executable permission...";
@@ -548,7 +868,7 @@ void QMimeBinaryProvider::loadMimeTypePrivate(QMimeTypePrivate &data)
     QString mainPattern;
     const QString preferredLanguage = QLocale::system().name();
 
-    QListIterator<QString> mimeFilesIter(mimeFiles);
+    QListIterator<QString> mimeFilesIter(xmlFiles);
     mimeFilesIter.toBack();
     while (mimeFilesIter.hasPrevious()) { // global first, then local.
         const QString fullPath = mimeFilesIter.previous();
@@ -579,7 +899,8 @@ void QMimeBinaryProvider::loadMimeTypePrivate(QMimeTypePrivate &data)
                     data.localeComments.insert(lang, text);
                     continue; // we called readElementText, so we're at the EndElement already.
                 } else if (tag == QLatin1String("icon")) { // as written out by shared-mime-info >= 0.40
-                    data.iconName = xml.attributes().value(QLatin1String("name")).toString();
+                    if (!data.isLoaded(QMimeTypePrivate::IconLoaded)) // otherwise other threads may be reading it
+                        data.iconName = xml.attributes().value(QLatin1String("name")).toString();
                 } else if (tag == QLatin1String("glob-deleteall")) { // as written out by shared-mime-info >= 0.70
                     data.globPatterns.clear();
                 } else if (tag == QLatin1String("glob")) { // as written out by shared-mime-info >= 0.70
@@ -647,34 +968,44 @@ QString QMimeBinaryProvider::iconForMime(CacheFile *cacheFile, int posListOffset
 
 void QMimeBinaryProvider::loadIcon(QMimeTypePrivate &data)
 {
-    checkCache();
+    if (data.isLoaded(QMimeTypePrivate::IconLoaded))
+        return;
+    QMutexLocker locker(mimeTypeLoadMutex());
+    if (data.isLoaded(QMimeTypePrivate::IconLoaded))
+        return;
     const QByteArray inputMime = data.name.toLatin1();
     foreach (CacheFile *cacheFile, m_cacheFiles) {
         const QString icon = iconForMime(cacheFile, PosIconsListOffset, inputMime);
         if (!icon.isEmpty()) {
             data.iconName = icon;
-            return;
+            break;
         }
     }
+    data.setLoaded(QMimeTypePrivate::IconLoaded);
 }
 
 void QMimeBinaryProvider::loadGenericIcon(QMimeTypePrivate &data)
 {
-    checkCache();
+    if (data.isLoaded(QMimeTypePrivate::GenericIconLoaded))
+        return;
+    QMutexLocker locker(mimeTypeLoadMutex());
+    if (data.isLoaded(QMimeTypePrivate::GenericIconLoaded))
+        return;
     const QByteArray inputMime = data.name.toLatin1();
     foreach (CacheFile *cacheFile, m_cacheFiles) {
         const QString icon = iconForMime(cacheFile, PosGenericIconsListOffset, inputMime);
         if (!icon.isEmpty()) {
             data.genericIconName = icon;
-            return;
+            break;
         }
     }
+    data.setLoaded(QMimeTypePrivate::GenericIconLoaded);
 }
 
 ////
 
 QMimeXMLProvider::QMimeXMLProvider(QMimeDatabasePrivate *db)
-    : QMimeProviderBase(db), m_loaded(false)
+    : QMimeProviderBase(db), m_loaded(false), m_saveSnapshot(true)
 {
 }
 
@@ -685,84 +1016,186 @@ bool QMimeXMLProvider::isValid()
 
 QMimeType QMimeXMLProvider::mimeTypeForName(const QString &name)
 {
-    ensureLoaded();
-
     return m_nameMimeTypeMap.value(name);
 }
 
-QStringList QMimeXMLProvider::findByFileName(const QString &fileName, QString *foundSuffix)
+QStringList QMimeXMLProvider::findByFileName(const QMimeGlobLookupContext &context, QString *foundSuffix)
 {
-    ensureLoaded();
-
-    const QStringList matchingMimeTypes = m_mimeTypeGlobs.matchingGlobs(fileName, foundSuffix);
+    const QStringList matchingMimeTypes = m_mimeTypeGlobs.matchingGlobs(context, foundSuffix);
     return matchingMimeTypes;
 }
 
-QMimeType QMimeXMLProvider::findByMagic(const QByteArray &data, int *accuracyPtr)
+QMimeType QMimeXMLProvider::findByMagic(const char *data, int dataSize, int *accuracyPtr, QMimeMagicLookupStats *stats)
 {
-    ensureLoaded();
+    const QString candidate = m_magicProgram.findMatch(data, dataSize, accuracyPtr, stats);
+    return mimeTypeForName(candidate);
+}
 
-    QString candidate;
+int QMimeXMLProvider::magicMaxExtent()
+{
+    return m_magicProgram.maxExtent();
+}
 
-    foreach (const QMimeMagicRuleMatcher &matcher, m_magicMatchers) {
-        if (matcher.matches(data)) {
-            const int priority = matcher.priority();
-            if (priority > *accuracyPtr) {
-                *accuracyPtr = priority;
-                candidate = matcher.mimetype();
-            }
+int QMimeXMLProvider::magicDataNeeded(const char *data, int dataSize)
+{
+    return m_magicProgram.dataNeeded(data, dataSize);
+}
+
+#ifndef QMIME_NO_BUILTIN_DATABASE
+// freedesktop.org.xml serialized by qmimedatabasegen, see QMimeXMLPackage::write()
+extern const unsigned char qmime_builtin_database[];
+extern const int qmime_builtin_database_size;
+
+static QByteArray builtinDatabase()
+{
+    return QByteArray::fromRawData(reinterpret_cast<const char *>(qmime_builtin_database), qmime_builtin_database_size);
+}
+#endif
+
+static QString builtinDatabaseFile()
+{
+    return QLatin1String(":/qt-project.org/qmime/freedesktop.org.xml");
+}
+
+QStringList QMimeXMLProvider::packageFiles()
+{
+    bool fdoXmlFound = false;
+    QStringList allFiles;
+
+    const QStringList packageDirs = QStandardPaths::locateAll(QStandardPaths::GenericDataLocation, QLatin1String("mime/packages"), QStandardPaths::LocateDirectory);
+    //qDebug() << "packageDirs=" << packageDirs;
+    foreach (const QString &packageDir, packageDirs) {
+        QDir dir(packageDir);
+        const QStringList files = dir.entryList(QDir::Files | QDir::NoDotAndDotDot);
+        //qDebug() << Q_FUNC_INFO << packageDir << files;
+        if (!fdoXmlFound)
+            fdoXmlFound = files.contains(QLatin1String("freedesktop.org.xml"));
+        QStringList::const_iterator endIt(files.constEnd());
+        for (QStringList::const_iterator it(files.constBegin()); it != endIt; ++it) {
+            allFiles.append(packageDir + QLatin1Char('/') + *it);
         }
     }
-    return mimeTypeForName(candidate);
+
+    if (!fdoXmlFound) {
+        // We could instead install the file as part of installing Qt?
+        allFiles.prepend(builtinDatabaseFile());
+    }
+    return allFiles;
 }
 
 void QMimeXMLProvider::ensureLoaded()
 {
-    if (!m_loaded || shouldCheck()) {
-        bool fdoXmlFound = false;
-        QStringList allFiles;
-
-        const QStringList packageDirs = QStandardPaths::locateAll(QStandardPaths::GenericDataLocation, QLatin1String("mime/packages"), QStandardPaths::LocateDirectory);
-        //qDebug() << "packageDirs=" << packageDirs;
-        foreach (const QString &packageDir, packageDirs) {
-            QDir dir(packageDir);
-            const QStringList files = dir.entryList(QDir::Files | QDir::NoDotAndDotDot);
-            //qDebug() << static_cast<const void *>(this) << Q_FUNC_INFO << packageDir << files;
-            if (!fdoXmlFound)
-                fdoXmlFound = files.contains(QLatin1String("freedesktop.org.xml"));
-            QStringList::const_iterator endIt(files.constEnd());
-            for (QStringList::const_iterator it(files.constBegin()); it != endIt; ++it) {
-                allFiles.append(packageDir + QLatin1Char('/') + *it);
-            }
-        }
+    if (m_loaded)
+        return;
+    const QStringList files = packageFiles();
+    loadPackageFiles(files, packagesKey(files));
+}
 
-        if (!fdoXmlFound) {
-            // We could instead install the file as part of installing Qt?
-            allFiles.prepend(QLatin1String(":/qt-project.org/qmime/freedesktop.org.xml"));
-        }
+/*!
+    \internal
+    Loads the package \a files, from the snapshot if there is one for \a key, which
+    the caller already computed with packagesKey().
+*/
+void QMimeXMLProvider::loadPackageFiles(const QStringList &files, const QByteArray &key)
+{
+    m_loaded = true;
+    m_allFiles = files;
 
-        if (m_allFiles == allFiles)
-            return;
-        m_allFiles = allFiles;
+    const QString snapshotFile = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+            + QString::fromLatin1("/qmime/xml-%1.snapshot").arg(qHash(key), 8, 16, QLatin1Char('0'));
+    if (!loadSnapshot(snapshotFile, key)) {
+        //qDebug() << "Loading" << m_allFiles;
+        loadPackages();
+        if (m_saveSnapshot)
+            saveSnapshot(snapshotFile, key);
+    }
 
-        m_nameMimeTypeMap.clear();
-        m_aliases.clear();
-        m_parents.clear();
-        m_mimeTypeGlobs.clear();
-        m_magicMatchers.clear();
+    m_magicProgram.build();
+    buildAncestorClosure(m_nameMimeTypeMap.keys());
+}
 
-        //qDebug() << "Loading" << m_allFiles;
+bool QMimeXMLProvider::isUpToDate() const
+{
+    return packageFiles() == m_allFiles;
+}
+
+/*!
+    \internal
+    Parses the package files on the global thread pool, each into a QMimeXMLPackage,
+    then adds them in the order of m_allFiles, so that later files still override
+    earlier ones exactly as when they were loaded one after the other.
+*/
+void QMimeXMLProvider::loadPackages()
+{
+    QVector<QMimeXMLPackage> packages;
+    packages.reserve(m_allFiles.count());
+    foreach (const QString &file, m_allFiles) {
+#ifndef QMIME_NO_BUILTIN_DATABASE
+        if (file == builtinDatabaseFile())
+            continue;
+#endif
+        packages.append(QMimeXMLPackage(file));
+    }
+
+#ifndef QT_NO_CONCURRENT
+    if (packages.count() > 1)
+        QtConcurrent::blockingMap(packages, parsePackage);
+    else
+#endif
+    for (int i = 0; i < packages.count(); ++i)
+        parsePackage(packages[i]);
+
+    int packageIndex = 0;
+    foreach (const QString &file, m_allFiles) {
+#ifndef QMIME_NO_BUILTIN_DATABASE
+        if (file == builtinDatabaseFile()) {
+            QByteArray data = builtinDatabase();
+            QBuffer buffer(&data);
+            buffer.open(QIODevice::ReadOnly);
+            QMimeXMLPackage builtinPackage(file);
+            if (builtinPackage.read(&buffer, QByteArray()))
+                addPackage(builtinPackage);
+            else
+                qWarning("QMimeDatabase: Error loading the built-in database");
+            continue;
+        }
+#endif
+        const QMimeXMLPackage &package = packages.at(packageIndex++);
+        if (!package.ok)
+            qWarning("QMimeDatabase: Error loading %s\n%s", qPrintable(package.fileName), qPrintable(package.errorMessage));
+        // What was parsed before an error is kept, as before
+        addPackage(package);
+    }
+}
 
-        foreach (const QString &file, allFiles)
-            load(file);
+/*!
+    \internal
+    Runs in a worker thread: only touches \a package.
+*/
+void QMimeXMLProvider::parsePackage(QMimeXMLPackage &package)
+{
+    QFile file(package.fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        package.errorMessage = QString::fromLatin1("Cannot open %1: %2").arg(package.fileName, file.errorString());
+        return;
     }
+
+    QMimePackageParser parser(package);
+    package.ok = parser.parse(&file, package.fileName, &package.errorMessage);
 }
 
-void QMimeXMLProvider::load(const QString &fileName)
+void QMimeXMLProvider::addPackage(const QMimeXMLPackage &package)
 {
-    QString errorMessage;
-    if (!load(fileName, &errorMessage))
-        qWarning("QMimeDatabase: Error loading %s\n%s", qPrintable(fileName), qPrintable(errorMessage));
+    foreach (const QMimeType &mt, package.mimeTypes)
+        addMimeType(mt);
+    foreach (const QMimeGlobPattern &glob, package.globs)
+        addGlobPattern(glob);
+    for (int i = 0; i < package.parents.count(); ++i)
+        addParent(package.parents.at(i).first, package.parents.at(i).second);
+    for (int i = 0; i < package.aliases.count(); ++i)
+        addAlias(package.aliases.at(i).first, package.aliases.at(i).second);
+    foreach (const QMimeMagicRuleMatcher &matcher, package.magicMatchers)
+        addMagicMatcher(matcher);
 }
 
 bool QMimeXMLProvider::load(const QString &fileName, QString *errorMessage)
@@ -783,9 +1216,159 @@ bool QMimeXMLProvider::load(const QString &fileName, QString *errorMessage)
     return parser.parse(&file, fileName, errorMessage);
 }
 
+QMIME_EXPORT int qmime_xmlSnapshotsLoaded = 0; // exported for the unit test
+
+static const int maxSnapshots = 4; // e.g. for processes with different XDG_DATA_DIRS
+
+// The built-in database doesn't change while the library is loaded: hashed once
+struct BuiltinDatabaseStamp
+{
+    BuiltinDatabaseStamp()
+    {
+#ifndef QMIME_NO_BUILTIN_DATABASE
+        const QByteArray data = builtinDatabase();
+#else
+        const QResource resource(builtinDatabaseFile());
+        const QByteArray data = QByteArray::fromRawData(reinterpret_cast<const char *>(resource.data()), int(resource.size()));
+#endif
+        size = data.size();
+        hash = qHash(data);
+    }
+
+    qint64 size;
+    quint32 hash;
+};
+
+Q_GLOBAL_STATIC(BuiltinDatabaseStamp, builtinDatabaseStamp)
+
+/*!
+    \internal
+    Identifies a set of package \a files: a snapshot, or a generated mime.cache,
+    is only used for exactly the same files. This runs on each check for changes,
+    so the files are only stat'ed, not read: a file replaced by another one, as
+    package managers do, has another inode, and a file rewritten in place has
+    other modification and change times, to the nanosecond where available.
+*/
+QByteArray QMimeXMLProvider::packagesKey(const QStringList &files)
+{
+    QByteArray key;
+    QDataStream stream(&key, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_4_6);
+    foreach (const QString &fileName, files) {
+        stream << fileName;
+        if (fileName == builtinDatabaseFile()) {
+            // Built into the library, without a modification time
+            stream << builtinDatabaseStamp()->size << builtinDatabaseStamp()->hash;
+            continue;
+        }
+#ifdef Q_OS_UNIX
+        QT_STATBUF statBuffer;
+        if (QT_STAT(QFile::encodeName(fileName).constData(), &statBuffer) != 0)
+            continue;
+        stream << qint64(statBuffer.st_size) << quint64(statBuffer.st_ino)
+               << qint64(statBuffer.st_mtime) << qint64(statBuffer.st_ctime);
+#if defined(Q_OS_LINUX)
+        stream << qint64(statBuffer.st_mtim.tv_nsec) << qint64(statBuffer.st_ctim.tv_nsec);
+#elif defined(Q_OS_MAC) || defined(Q_OS_BSD4)
+        stream << qint64(statBuffer.st_mtimespec.tv_nsec) << qint64(statBuffer.st_ctimespec.tv_nsec);
+#endif
+#else
+        const QFileInfo fileInfo(fileName);
+        stream << fileInfo.size() << fileInfo.lastModified() << fileInfo.created();
+#endif
+    }
+    return key;
+}
+
+/*!
+    \internal
+    Loads the state saved by saveSnapshot() from \a fileName, instead of parsing
+    the XML files. Returns false, without changing anything, if the file doesn't
+    exist, is invalid, or was written for other package files than \a key.
+*/
+bool QMimeXMLProvider::loadSnapshot(const QString &fileName, const QByteArray &key)
+{
+    QFile file(fileName);
+    QMimeXMLPackage package(fileName);
+    if (!file.open(QIODevice::ReadOnly) || !package.read(&file, key))
+        return false;
+    addPackage(package);
+    ++qmime_xmlSnapshotsLoaded;
+    return true;
+}
+
+/*!
+    \internal
+    Writes what was parsed from the XML files to \a fileName, for the next processes.
+    The compiled globs and magic are rebuilt from it, which is still much faster
+    than parsing. Failing to write the snapshot is not an error.
+*/
+void QMimeXMLProvider::saveSnapshot(const QString &fileName, const QByteArray &key) const
+{
+    const QString snapshotDir = QFileInfo(fileName).absolutePath();
+    if (!QDir().mkpath(snapshotDir))
+        return;
+    // Written aside and renamed, so that other processes never see a partial file
+    QTemporaryFile file(fileName + QLatin1String(".XXXXXX"));
+    if (!file.open() || !snapshot().write(&file, key) || !file.flush())
+        return;
+    QFile::remove(fileName);
+    if (!file.rename(fileName))
+        return;
+    file.setAutoRemove(false);
+
+    QDir dir(snapshotDir);
+    const QStringList snapshots = dir.entryList(QStringList(QLatin1String("xml-*.snapshot")), QDir::Files, QDir::Time);
+    for (int i = maxSnapshots; i < snapshots.count(); ++i)
+        dir.remove(snapshots.at(i));
+}
+
+/*!
+    \internal
+    Returns everything parsed so far, as one package.
+*/
+QMimeXMLPackage QMimeXMLProvider::snapshot() const
+{
+    QMimeXMLPackage package;
+    package.mimeTypes = m_nameMimeTypeMap.values();
+    package.globs = m_globs;
+    for (ParentsHash::const_iterator it = m_parents.constBegin(); it != m_parents.constEnd(); ++it) {
+        foreach (const QString &parent, it.value())
+            package.parents.append(qMakePair(it.key(), parent));
+    }
+    for (AliasHash::const_iterator it = m_aliases.constBegin(); it != m_aliases.constEnd(); ++it)
+        package.aliases.append(qMakePair(it.key(), it.value()));
+    package.magicMatchers = m_magicMatchers;
+    return package;
+}
+
+/*!
+    \internal
+    Writes what was parsed from the XML files into \a mimeDir, as update-mime-database
+    does, for the binary provider.
+*/
+bool QMimeXMLProvider::writeMimeCache(const QString &mimeDir, QString *errorMessage) const
+{
+    QMimeCacheWriter writer;
+    for (NameMimeTypeMap::const_iterator it = m_nameMimeTypeMap.constBegin(); it != m_nameMimeTypeMap.constEnd(); ++it)
+        writer.addMimeType(*it.value().d);
+    for (AliasHash::const_iterator it = m_aliases.constBegin(); it != m_aliases.constEnd(); ++it)
+        writer.addAlias(it.key(), it.value());
+    for (ParentsHash::const_iterator it = m_parents.constBegin(); it != m_parents.constEnd(); ++it) {
+        foreach (const QString &parent, it.value())
+            writer.addParent(it.key(), parent);
+    }
+    foreach (const QMimeGlobPattern &glob, m_globs)
+        writer.addGlobPattern(glob);
+    foreach (const QMimeMagicRuleMatcher &matcher, m_magicMatchers)
+        writer.addMagicMatcher(matcher);
+    return writer.write(mimeDir, errorMessage);
+}
+
 void QMimeXMLProvider::addGlobPattern(const QMimeGlobPattern &glob)
 {
     m_mimeTypeGlobs.addGlob(glob);
+    m_globs.append(glob);
 }
 
 void QMimeXMLProvider::addMimeType(const QMimeType &mt)
@@ -795,7 +1378,6 @@ void QMimeXMLProvider::addMimeType(const QMimeType &mt)
 
 QStringList QMimeXMLProvider::parents(const QString &mime)
 {
-    ensureLoaded();
     QStringList result = m_parents.value(mime);
     if (result.isEmpty()) {
         const QString parent = fallbackParent(mime);
@@ -812,7 +1394,6 @@ void QMimeXMLProvider::addParent(const QString &child, const QString &parent)
 
 QString QMimeXMLProvider::resolveAlias(const QString &name)
 {
-    ensureLoaded();
     return m_aliases.value(name, name);
 }
 
@@ -823,13 +1404,52 @@ void QMimeXMLProvider::addAlias(const QString &alias, const QString &name)
 
 QList<QMimeType> QMimeXMLProvider::allMimeTypes()
 {
-    ensureLoaded();
     return m_nameMimeTypeMap.values();
 }
 
 void QMimeXMLProvider::addMagicMatcher(const QMimeMagicRuleMatcher &matcher)
 {
+    m_magicProgram.addMatcher(matcher);
     m_magicMatchers.append(matcher);
 }
 
+static QString packagesKeyFile(const QString &mimeDir)
+{
+    return mimeDir + QLatin1String("/qmime-packages.key");
+}
+
+QMimeGeneratedCacheProvider::QMimeGeneratedCacheProvider(QMimeDatabasePrivate *db, const QString &mimeDir, const QByteArray &packagesKey)
+    : QMimeBinaryProvider(db, mimeDir), m_packagesKeyFile(packagesKeyFile(mimeDir)), m_packagesKey(packagesKey)
+{
+}
+
+/*!
+    \internal
+    The directory is named after a 32-bit hash of the packages key, which can collide:
+    the whole key, saved next to the mime.cache, must match too.
+*/
+bool QMimeGeneratedCacheProvider::isValid()
+{
+    QFile file(m_packagesKeyFile);
+    if (!file.open(QIODevice::ReadOnly) || file.readAll() != m_packagesKey)
+        return false;
+    return QMimeBinaryProvider::isValid();
+}
+
+bool QMimeGeneratedCacheProvider::writePackagesKey(const QString &mimeDir, const QByteArray &packagesKey, QString *errorMessage)
+{
+    QFile file(packagesKeyFile(mimeDir));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(packagesKey) != packagesKey.size()) {
+        *errorMessage = QString::fromLatin1("Cannot write %1: %2").arg(file.fileName(), file.errorString());
+        return false;
+    }
+    return true;
+}
+
+bool QMimeGeneratedCacheProvider::isUpToDate() const
+{
+    return QMimeXMLProvider::packagesKey(QMimeXMLProvider::packageFiles()) == m_packagesKey
+        && QMimeBinaryProvider::isUpToDate();
+}
+
 QT_END_NAMESPACE
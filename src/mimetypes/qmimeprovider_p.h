@@ -42,13 +42,21 @@
 #ifndef QMIMEPROVIDER_P_H
 #define QMIMEPROVIDER_P_H
 
+#include <QtCore/qbitarray.h>
 #include <QtCore/qdatetime.h>
 #include "qmimedatabase_p.h"
-#include <QtCore/qset.h>
+#include "qmimemagicrulematcher_p.h"
+#include "qmimemagicruleprogram_p.h"
+#include "qmimexmlpackage_p.h"
+#include <QtCore/qmutex.h>
+
+#if defined(Q_OS_UNIX) && !defined(Q_OS_INTEGRITY)
+#define QT_USE_MMAP // needed by the binary provider
+#endif
 
 QT_BEGIN_NAMESPACE
 
-class QMimeMagicRuleMatcher;
+class QIODevice;
 
 class QMimeProviderBase
 {
@@ -57,37 +65,59 @@ public:
     virtual ~QMimeProviderBase() {}
 
     virtual bool isValid() = 0;
+    // Loads everything the lookups need: afterwards, the provider is never modified
+    virtual void ensureLoaded() = 0;
+    // Returns false if the files the provider was loaded from changed since
+    virtual bool isUpToDate() const = 0;
     virtual QMimeType mimeTypeForName(const QString &name) = 0;
-    virtual QStringList findByFileName(const QString &fileName, QString *foundSuffix) = 0;
+    virtual QStringList findByFileName(const QMimeGlobLookupContext &context, QString *foundSuffix) = 0;
     virtual QStringList parents(const QString &mime) = 0;
     virtual QString resolveAlias(const QString &name) = 0;
-    virtual QMimeType findByMagic(const QByteArray &data, int *accuracyPtr) = 0;
+    virtual QMimeType findByMagic(const char *data, int dataSize, int *accuracyPtr, QMimeMagicLookupStats *stats = 0) = 0;
+    virtual int magicMaxExtent() = 0;
+    virtual int magicDataNeeded(const char *data, int dataSize) = 0;
     virtual QList<QMimeType> allMimeTypes() = 0;
     virtual void loadMimeTypePrivate(QMimeTypePrivate &) {}
     virtual void loadIcon(QMimeTypePrivate &) {}
     virtual void loadGenericIcon(QMimeTypePrivate &) {}
 
+    bool inherits(const QString &mime, const QString &parent);
+    QStringList allAncestors(const QString &mime);
+
     QMimeDatabasePrivate *m_db;
+    // One reference held by the database while this is the current provider,
+    // plus one per thread using it. The last one deletes the provider.
+    QAtomicInt m_refCount;
 protected:
-    bool shouldCheck();
-    QDateTime m_lastCheck;
+    void buildAncestorClosure(const QStringList &mimeTypeNames);
+
+private:
+    // Dense IDs: first the types of the provider, then the other names used as parents
+    QHash<QString, int> m_typeIds;
+    int m_knownTypeCount;
+    QVector<QBitArray> m_ancestors; // by ID, with the bits of the type itself and of all its ancestors
+    QVector<QStringList> m_allAncestors; // by ID, see QMimeType::allAncestors()
 };
 
 /*
-   Parses the files 'mime.cache' and 'types' on demand
+   Parses the files 'mime.cache' and 'types' when loaded
  */
 class QMimeBinaryProvider : public QMimeProviderBase
 {
 public:
-    QMimeBinaryProvider(QMimeDatabasePrivate *db);
+    QMimeBinaryProvider(QMimeDatabasePrivate *db, const QString &mimeDir = QString());
     virtual ~QMimeBinaryProvider();
 
     virtual bool isValid();
+    virtual void ensureLoaded();
+    virtual bool isUpToDate() const;
     virtual QMimeType mimeTypeForName(const QString &name);
-    virtual QStringList findByFileName(const QString &fileName, QString *foundSuffix);
+    virtual QStringList findByFileName(const QMimeGlobLookupContext &context, QString *foundSuffix);
     virtual QStringList parents(const QString &mime);
     virtual QString resolveAlias(const QString &name);
-    virtual QMimeType findByMagic(const QByteArray &data, int *accuracyPtr);
+    virtual QMimeType findByMagic(const char *data, int dataSize, int *accuracyPtr, QMimeMagicLookupStats *stats = 0);
+    virtual int magicMaxExtent();
+    virtual int magicDataNeeded(const char *data, int dataSize);
     virtual QList<QMimeType> allMimeTypes();
     virtual void loadMimeTypePrivate(QMimeTypePrivate &);
     virtual void loadIcon(QMimeTypePrivate &);
@@ -96,23 +126,33 @@ public:
 private:
     struct CacheFile;
 
-    void matchGlobList(QMimeGlobMatchResult &result, CacheFile *cacheFile, int offset, const QString &fileName);
-    bool matchSuffixTree(QMimeGlobMatchResult &result, CacheFile *cacheFile, int numEntries, int firstOffset, const QString &fileName, int charPos, bool caseSensitiveCheck);
-    bool matchMagicRule(CacheFile *cacheFile, int numMatchlets, int firstOffset, const QByteArray &data);
+    enum SuffixTreeWalk {
+        FoldedAndExactWalk, // the folded and the exact characters are the same so far
+        FoldedWalk,         // following the lowercased file name: case-insensitive globs
+        ExactWalk           // following the file name as is: case-sensitive globs
+    };
+    enum SuffixTreeMatch { // combined, when walking the folded and the exact file name at once
+        NoSuffixMatch = 0x0,
+        FoldedSuffixMatch = 0x1,
+        ExactSuffixMatch = 0x2
+    };
+    int matchSuffixTree(QMimeGlobMatchResult &result, QMimeGlobMatchResult &exactResult, CacheFile *cacheFile, int numEntries, int firstOffset, const QMimeGlobLookupContext &context, int charPos, SuffixTreeWalk walk);
+    bool matchMagicRule(CacheFile *cacheFile, int numMatchlets, int firstOffset, const char *dataPtr, int dataSize, QMimeMagicStringScanner::Result *scanResult, QMimeMagicLookupStats *stats);
+    enum MagicMatchState { NoMagicMatch, MagicMatch, MagicUndecided };
+    MagicMatchState magicMatchState(CacheFile *cacheFile, int numMatchlets, int firstOffset, const char *dataPtr, int dataSize);
     QString iconForMime(CacheFile *cacheFile, int posListOffset, const QByteArray &inputMime);
+    QMimeType mimeTypeForNameUnchecked(const QString &name) const;
+    void loadMimeTypeXml(QMimeTypePrivate &data);
+    void loadCacheFiles();
     void loadMimeTypeList();
-    void checkCache();
+    QStringList mimeFiles(const QString &fileName) const;
 
-    class CacheFileList : public QList<CacheFile *>
-    {
-    public:
-        CacheFile *findCacheFile(const QString &fileName) const;
-        bool checkCacheChanged();
-    };
-    CacheFileList m_cacheFiles;
+    QString m_mimeDir; // if empty, the mime directories of the XDG data dirs
+    QList<CacheFile *> m_cacheFiles;
     QStringList m_cacheFileNames;
-    QSet<QString> m_mimetypeNames;
-    bool m_mimetypeListLoaded;
+    // One instance per type, shared by all the QMimeTypes returned, filled in on demand
+    // (see mimeTypeLoadMutex in qmimeprovider.cpp)
+    QHash<QString, QMimeType> m_mimeTypes;
 };
 
 /*
@@ -124,14 +164,25 @@ public:
     QMimeXMLProvider(QMimeDatabasePrivate *db);
 
     virtual bool isValid();
+    virtual void ensureLoaded();
+    virtual bool isUpToDate() const;
     virtual QMimeType mimeTypeForName(const QString &name);
-    virtual QStringList findByFileName(const QString &fileName, QString *foundSuffix);
+    virtual QStringList findByFileName(const QMimeGlobLookupContext &context, QString *foundSuffix);
     virtual QStringList parents(const QString &mime);
     virtual QString resolveAlias(const QString &name);
-    virtual QMimeType findByMagic(const QByteArray &data, int *accuracyPtr);
+    virtual QMimeType findByMagic(const char *data, int dataSize, int *accuracyPtr, QMimeMagicLookupStats *stats = 0);
+    virtual int magicMaxExtent();
+    virtual int magicDataNeeded(const char *data, int dataSize);
     virtual QList<QMimeType> allMimeTypes();
 
     bool load(const QString &fileName, QString *errorMessage);
+    void loadPackageFiles(const QStringList &files, const QByteArray &packagesKey);
+    // Off when a mime.cache is generated instead, see QMimeDatabasePrivate::createGeneratedCacheProvider()
+    void setSaveSnapshot(bool save) { m_saveSnapshot = save; }
+    bool writeMimeCache(const QString &mimeDir, QString *errorMessage) const;
+
+    static QStringList packageFiles();
+    static QByteArray packagesKey(const QStringList &files);
 
     // Called by the mimetype xml parser
     void addMimeType(const QMimeType &mt);
@@ -141,10 +192,15 @@ public:
     void addMagicMatcher(const QMimeMagicRuleMatcher &matcher);
 
 private:
-    void ensureLoaded();
-    void load(const QString &fileName);
+    void loadPackages();
+    void addPackage(const QMimeXMLPackage &package);
+    static void parsePackage(QMimeXMLPackage &package);
+    bool loadSnapshot(const QString &fileName, const QByteArray &key);
+    void saveSnapshot(const QString &fileName, const QByteArray &key) const;
+    QMimeXMLPackage snapshot() const;
 
     bool m_loaded;
+    bool m_saveSnapshot;
 
     typedef QHash<QString, QMimeType> NameMimeTypeMap;
     NameMimeTypeMap m_nameMimeTypeMap;
@@ -156,8 +212,32 @@ private:
     ParentsHash m_parents;
     QMimeAllGlobPatterns m_mimeTypeGlobs;
 
-    QList<QMimeMagicRuleMatcher> m_magicMatchers;
+    QMimeMagicRuleProgram m_magicProgram;
     QStringList m_allFiles;
+
+    // As parsed, for the snapshot and the mime.cache
+    QList<QMimeGlobPattern> m_globs;
+    QList<QMimeMagicRuleMatcher> m_magicMatchers;
+};
+
+/*
+   Maps the mime.cache written by QMimeXMLProvider::writeMimeCache() into the user's
+   cache directory, when there is no system one: it is up to date as long as the
+   XML files it was written from didn't change.
+ */
+class QMimeGeneratedCacheProvider : public QMimeBinaryProvider
+{
+public:
+    QMimeGeneratedCacheProvider(QMimeDatabasePrivate *db, const QString &mimeDir, const QByteArray &packagesKey);
+
+    virtual bool isValid();
+    virtual bool isUpToDate() const;
+
+    static bool writePackagesKey(const QString &mimeDir, const QByteArray &packagesKey, QString *errorMessage);
+
+private:
+    QString m_packagesKeyFile;
+    QByteArray m_packagesKey;
 };
 
 QT_END_NAMESPACE
@@ -52,70 +52,6 @@
 
 QT_BEGIN_NAMESPACE
 
-bool qt_isQMimeTypeDebuggingActivated (false);
-
-#ifndef QT_NO_DEBUG_OUTPUT
-#define DBG() if (qt_isQMimeTypeDebuggingActivated) qDebug() << static_cast<const void *>(this) << Q_FUNC_INFO
-#else
-#define DBG() if (0) qDebug() << static_cast<const void *>(this) << Q_FUNC_INFO
-#endif
-
-QMimeTypePrivate::QMimeTypePrivate()
-        //name(),
-        //localeComments(),
-        //genericIconName(),
-        //iconName(),
-        //globPatterns()
-        : loaded(false)
-{}
-
-QMimeTypePrivate::QMimeTypePrivate(const QMimeType &other)
-        : name(other.d->name),
-        localeComments(other.d->localeComments),
-        genericIconName(other.d->genericIconName),
-        iconName(other.d->iconName),
-        globPatterns(other.d->globPatterns),
-        loaded(other.d->loaded)
-{}
-
-void QMimeTypePrivate::clear()
-{
-    name.clear();
-    localeComments.clear();
-    genericIconName.clear();
-    iconName.clear();
-    globPatterns.clear();
-    loaded = false;
-}
-
-/*!
-    \fn bool QMimeTypePrivate::operator==(const QMimeTypePrivate &other) const;
-    Returns true if \a other equals this QMimeTypePrivate object, otherwise returns false.
- */
-bool QMimeTypePrivate::operator==(const QMimeTypePrivate &other) const
-{
-    DBG();
-    if (name == other.name &&
-            localeComments == other.localeComments &&
-            genericIconName == other.genericIconName &&
-            iconName == other.iconName &&
-            globPatterns == other.globPatterns) {
-        return true;
-    }
-
-    DBG() << name << other.name << (name == other.name);
-    DBG() << localeComments << other.localeComments << (localeComments == other.localeComments);
-    DBG() << genericIconName << other.genericIconName << (genericIconName == other.genericIconName);
-    DBG() << iconName << other.iconName << (iconName == other.iconName);
-    DBG() << globPatterns << other.globPatterns << (globPatterns == other.globPatterns);
-    return false;
-}
-
-void QMimeTypePrivate::addGlobPattern(const QString &pattern)
-{
-    globPatterns.append(pattern);
-}
-
 /*!
     \class QMimeType
     \brief The QMimeType class describes types of file or data, represented by a MIME type string.
@@ -140,117 +76,6 @@ void QMimeTypePrivate::addGlobPattern(const QString &pattern)
     \sa QMimeDatabase
  */
 
-/*!
-    \fn QMimeType::QMimeType();
-    Constructs this QMimeType object initialized with default property values that indicate an invalid MIME type.
- */
-QMimeType::QMimeType() :
-        d(new QMimeTypePrivate())
-{
-    DBG() << "name():" << name();
-    //DBG() << "aliases():" << aliases();
-    DBG() << "genericIconName():" << genericIconName();
-    DBG() << "iconName():" << iconName();
-    DBG() << "globPatterns():" << globPatterns();
-    DBG() << "suffixes():" << suffixes();
-    DBG() << "preferredSuffix():" << preferredSuffix();
-}
-
-/*!
-    \fn QMimeType::QMimeType(const QMimeType &other);
-    Constructs this QMimeType object as a copy of \a other.
- */
-QMimeType::QMimeType(const QMimeType &other) :
-        d(other.d)
-{
-    DBG() << "name():" << name();
-    //DBG() << "aliases():" << aliases();
-    DBG() << "genericIconName():" << genericIconName();
-    DBG() << "iconName():" << iconName();
-    DBG() << "globPatterns():" << globPatterns();
-    DBG() << "suffixes():" << suffixes();
-    DBG() << "preferredSuffix():" << preferredSuffix();
-}
-
-/*!
-    \fn QMimeType &QMimeType::operator=(const QMimeType &other);
-    Assigns the data of \a other to this QMimeType object, and returns a reference to this object.
- */
-QMimeType &QMimeType::operator=(const QMimeType &other)
-{
-    if (d != other.d)
-        d = other.d;
-    return *this;
-}
-
-/*!
-    \fn QMimeType::QMimeType(const QMimeTypePrivate &dd);
-    Assigns the data of the QMimeTypePrivate \a dd to this QMimeType object, and returns a reference to this object.
- */
-QMimeType::QMimeType(const QMimeTypePrivate &dd) :
-        d(new QMimeTypePrivate(dd))
-{
-    DBG() << "name():" << name();
-    //DBG() << "aliases():" << aliases();
-    DBG() << "genericIconName():" << genericIconName();
-    DBG() << "iconName():" << iconName();
-    DBG() << "globPatterns():" << globPatterns();
-    DBG() << "suffixes():" << suffixes();
-    DBG() << "preferredSuffix():" << preferredSuffix();
-}
-
-/*!
-    \fn void QMimeType::swap(QMimeType &other);
-    Swaps QMimeType \a other with this QMimeType object.
-
-    This operation is very fast and never fails.
-
-    The swap() method helps with the implementation of assignment
-    operators in an exception-safe way. For more information consult
-    \l {http://en.wikibooks.org/wiki/More_C++_Idioms/Copy-and-swap}
-    {More C++ Idioms - Copy-and-swap}.
- */
-
-/*!
-    \fn QMimeType::~QMimeType();
-    Destroys the QMimeType object, and releases the d pointer.
- */
-QMimeType::~QMimeType()
-{
-    DBG() << "name():" << name();
-    //DBG() << "aliases():" << aliases();
-    DBG() << "genericIconName():" << genericIconName();
-    DBG() << "iconName():" << iconName();
-    DBG() << "globPatterns():" << globPatterns();
-    DBG() << "suffixes():" << suffixes();
-    DBG() << "preferredSuffix():" << preferredSuffix();
-}
-
-/*!
-    \fn bool QMimeType::operator==(const QMimeType &other) const;
-    Returns true if \a other equals this QMimeType object, otherwise returns false.
- */
-bool QMimeType::operator==(const QMimeType &other) const
-{
-    return d == other.d || *d == *other.d;
-}
-
-/*!
-    \fn bool QMimeType::operator!=(const QMimeType &other) const;
-    Returns true if \a other does not equal this QMimeType object, otherwise returns false.
- */
-
-/*!
-    \fn bool QMimeType::isValid() const;
-    Returns true if the QMimeType object contains valid data, otherwise returns false.
-    A valid MIME type has a non-empty name().
-    The invalid MIME type is the default-constructed QMimeType.
- */
-bool QMimeType::isValid() const
-{
-    return !d->name.isEmpty();
-}
-
 /*!
     \fn bool QMimeType::isDefault() const;
     Returns true if this MIME type is the default MIME type which
@@ -261,15 +86,6 @@ bool QMimeType::isDefault() const
     return d->name == QMimeDatabasePrivate::instance()->defaultMimeType();
 }
 
-/*!
-    \fn QString QMimeType::name() const;
-    Returns the name of the MIME type.
- */
-QString QMimeType::name() const
-{
-    return d->name;
-}
-
 /*!
     Returns the description of the MIME type to be displayed on user interfaces.
 
@@ -277,7 +93,8 @@ QString QMimeType::name() const
  */
 QString QMimeType::comment() const
 {
-    QMimeDatabasePrivate::instance()->provider()->loadMimeTypePrivate(*d);
+    QMimeProviderRef provider(QMimeDatabasePrivate::instance());
+    provider->loadMimeTypePrivate(*d);
 
     QStringList languageList;
     languageList << QLocale::system().name();
@@ -313,7 +130,8 @@ QString QMimeType::comment() const
  */
 QString QMimeType::genericIconName() const
 {
-    QMimeDatabasePrivate::instance()->provider()->loadGenericIcon(*d);
+    QMimeProviderRef provider(QMimeDatabasePrivate::instance());
+    provider->loadGenericIcon(*d);
     if (d->genericIconName.isEmpty()) {
         // From the spec:
         // If the generic icon name is empty (not specified by the mimetype definition)
@@ -337,13 +155,15 @@ QString QMimeType::genericIconName() const
  */
 QString QMimeType::iconName() const
 {
-    QMimeDatabasePrivate::instance()->provider()->loadIcon(*d);
+    QMimeProviderRef provider(QMimeDatabasePrivate::instance());
+    provider->loadIcon(*d);
     if (d->iconName.isEmpty()) {
         // Make default icon name from the mimetype name
-        d->iconName = name();
-        const int slashindex = d->iconName.indexOf(QLatin1Char('/'));
+        QString iconName = name();
+        const int slashindex = iconName.indexOf(QLatin1Char('/'));
         if (slashindex != -1)
-            d->iconName[slashindex] = QLatin1Char('-');
+            iconName[slashindex] = QLatin1Char('-');
+        return iconName;
     }
     return d->iconName;
 }
@@ -354,7 +174,8 @@ QString QMimeType::iconName() const
  */
 QStringList QMimeType::globPatterns() const
 {
-    QMimeDatabasePrivate::instance()->provider()->loadMimeTypePrivate(*d);
+    QMimeProviderRef provider(QMimeDatabasePrivate::instance());
+    provider->loadMimeTypePrivate(*d);
     return d->globPatterns;
 }
 
@@ -372,22 +193,8 @@ QStringList QMimeType::globPatterns() const
 */
 QStringList QMimeType::parentMimeTypes() const
 {
-    return QMimeDatabasePrivate::instance()->provider()->parents(d->name);
-}
-
-static void collectParentMimeTypes(const QString &mime, QStringList &allParents)
-{
-    QStringList parents = QMimeDatabasePrivate::instance()->provider()->parents(mime);
-    foreach (const QString &parent, parents) {
-        // I would use QSet, but since order matters I better not
-        if (!allParents.contains(parent))
-            allParents.append(parent);
-    }
-    // We want a breadth-first search, so that the least-specific parent (octet-stream) is last
-    // This means iterating twice, unfortunately.
-    foreach (const QString &parent, parents) {
-        collectParentMimeTypes(parent, allParents);
-    }
+    QMimeProviderRef provider(QMimeDatabasePrivate::instance());
+    return provider->parents(d->name);
 }
 
 /*!
@@ -402,9 +209,8 @@ static void collectParentMimeTypes(const QString &mime, QStringList &allParents)
 */
 QStringList QMimeType::allAncestors() const
 {
-    QStringList allParents;
-    collectParentMimeTypes(d->name, allParents);
-    return allParents;
+    QMimeProviderRef provider(QMimeDatabasePrivate::instance());
+    return provider->allAncestors(d->name);
 }
 
 /*!
@@ -413,7 +219,8 @@ QStringList QMimeType::allAncestors() const
  */
 QStringList QMimeType::suffixes() const
 {
-    QMimeDatabasePrivate::instance()->provider()->loadMimeTypePrivate(*d);
+    QMimeProviderRef provider(QMimeDatabasePrivate::instance());
+    provider->loadMimeTypePrivate(*d);
 
     QStringList result;
     foreach (const QString &pattern, d->globPatterns) {
@@ -445,7 +252,8 @@ QString QMimeType::preferredSuffix() const
 */
 QString QMimeType::filterString() const
 {
-    QMimeDatabasePrivate::instance()->provider()->loadMimeTypePrivate(*d);
+    QMimeProviderRef provider(QMimeDatabasePrivate::instance());
+    provider->loadMimeTypePrivate(*d);
     QString filter;
 
     if (!d->globPatterns.empty()) {
@@ -471,9 +279,9 @@ bool QMimeType::inherits(const QString &mimeTypeName) const
 {
     if (d->name == mimeTypeName)
         return true;
-    return QMimeDatabasePrivate::instance()->inherits(d->name, mimeTypeName);
+    QMimeDatabasePrivate *db = QMimeDatabasePrivate::instance();
+    QMimeProviderRef provider(db);
+    return db->inherits(d->name, mimeTypeName);
 }
 
-#undef DBG
-
 QT_END_NAMESPACE
@@ -44,6 +44,7 @@
 
 #include "qmimetype.h"
 
+#include <QtCore/qatomic.h>
 #include <QtCore/qhash.h>
 #include <QtCore/qstringlist.h>
 
@@ -54,6 +55,13 @@ class Q_AUTOTEST_EXPORT QMimeTypePrivate : public QSharedData
 public:
     typedef QHash<QString, QString> LocaleHash;
 
+    // The parts filled in on demand by the binary provider
+    enum LoadedPart {
+        DetailsLoaded = 0x1, // comments, icon and glob patterns, from the XML file of the type
+        IconLoaded = 0x2,
+        GenericIconLoaded = 0x4
+    };
+
     QMimeTypePrivate();
     explicit QMimeTypePrivate(const QMimeType &other);
 
@@ -63,12 +71,16 @@ public:
 
     void addGlobPattern(const QString &pattern);
 
+    inline bool isLoaded(LoadedPart part) const { return (int(loaded) & part) != 0; }
+    // Called with the provider's load mutex locked, once \a part is filled in
+    inline void setLoaded(LoadedPart part) { loaded.fetchAndStoreOrdered(int(loaded) | part); }
+
     QString name;
     LocaleHash localeComments;
     QString genericIconName;
     QString iconName;
     QStringList globPatterns;
-    bool loaded;
+    QAtomicInt loaded; // LoadedParts; the instances are shared between threads
 };
 
 QT_END_NAMESPACE
@@ -113,6 +113,31 @@ private:
     QMimeXMLProvider &m_provider;
 };
 
+class QMimePackageParser : public QMimeTypeParserBase
+{
+public:
+    explicit QMimePackageParser(QMimeXMLPackage &package) : m_package(package) {}
+
+protected:
+    inline bool process(const QMimeType &t, QString *)
+    { m_package.mimeTypes.append(t); return true; }
+
+    inline bool process(const QMimeGlobPattern &glob, QString *)
+    { m_package.globs.append(glob); return true; }
+
+    inline void processParent(const QString &child, const QString &parent)
+    { m_package.parents.append(qMakePair(child, parent)); }
+
+    inline void processAlias(const QString &alias, const QString &name)
+    { m_package.aliases.append(qMakePair(alias, name)); }
+
+    inline void processMagicMatcher(const QMimeMagicRuleMatcher &matcher)
+    { m_package.magicMatchers.append(matcher); }
+
+private:
+    QMimeXMLPackage &m_package;
+};
+
 QT_END_NAMESPACE
 
 #endif // MIMETYPEPARSER_P_H
@@ -0,0 +1,214 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtCore module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qmimetype.h"
+
+#include "qmimetype_p.h"
+
+#include <QtCore/QDebug>
+
+QT_BEGIN_NAMESPACE
+
+// The parts of QMimeType that don't need the database, for qmimedatabasegen
+
+bool qt_isQMimeTypeDebuggingActivated (false);
+
+#ifndef QT_NO_DEBUG_OUTPUT
+#define DBG() if (qt_isQMimeTypeDebuggingActivated) qDebug() << static_cast<const void *>(this) << Q_FUNC_INFO
+#else
+#define DBG() if (0) qDebug() << static_cast<const void *>(this) << Q_FUNC_INFO
+#endif
+
+QMimeTypePrivate::QMimeTypePrivate()
+        //name(),
+        //localeComments(),
+        //genericIconName(),
+        //iconName(),
+        //globPatterns()
+        : loaded(0)
+{}
+
+QMimeTypePrivate::QMimeTypePrivate(const QMimeType &other)
+        : name(other.d->name),
+        localeComments(other.d->localeComments),
+        genericIconName(other.d->genericIconName),
+        iconName(other.d->iconName),
+        globPatterns(other.d->globPatterns),
+        loaded(int(other.d->loaded))
+{}
+
+void QMimeTypePrivate::clear()
+{
+    name.clear();
+    localeComments.clear();
+    genericIconName.clear();
+    iconName.clear();
+    globPatterns.clear();
+    loaded = 0;
+}
+
+/*!
+    \fn bool QMimeTypePrivate::operator==(const QMimeTypePrivate &other) const;
+    Returns true if \a other equals this QMimeTypePrivate object, otherwise returns false.
+ */
+bool QMimeTypePrivate::operator==(const QMimeTypePrivate &other) const
+{
+    DBG();
+    if (name == other.name &&
+            localeComments == other.localeComments &&
+            genericIconName == other.genericIconName &&
+            iconName == other.iconName &&
+            globPatterns == other.globPatterns) {
+        return true;
+    }
+
+    DBG() << name << other.name << (name == other.name);
+    DBG() << localeComments << other.localeComments << (localeComments == other.localeComments);
+    DBG() << genericIconName << other.genericIconName << (genericIconName == other.genericIconName);
+    DBG() << iconName << other.iconName << (iconName == other.iconName);
+    DBG() << globPatterns << other.globPatterns << (globPatterns == other.globPatterns);
+    return false;
+}
+
+void QMimeTypePrivate::addGlobPattern(const QString &pattern)
+{
+    globPatterns.append(pattern);
+}
+
+/*!
+    \fn QMimeType::QMimeType();
+    Constructs this QMimeType object initialized with default property values that indicate an invalid MIME type.
+ */
+QMimeType::QMimeType() :
+        d(new QMimeTypePrivate())
+{
+    DBG() << "name():" << d->name;
+}
+
+/*!
+    \fn QMimeType::QMimeType(const QMimeType &other);
+    Constructs this QMimeType object as a copy of \a other.
+ */
+QMimeType::QMimeType(const QMimeType &other) :
+        d(other.d)
+{
+    DBG() << "name():" << d->name;
+}
+
+/*!
+    \fn QMimeType &QMimeType::operator=(const QMimeType &other);
+    Assigns the data of \a other to this QMimeType object, and returns a reference to this object.
+ */
+QMimeType &QMimeType::operator=(const QMimeType &other)
+{
+    if (d != other.d)
+        d = other.d;
+    return *this;
+}
+
+/*!
+    \fn QMimeType::QMimeType(const QMimeTypePrivate &dd);
+    Assigns the data of the QMimeTypePrivate \a dd to this QMimeType object, and returns a reference to this object.
+ */
+QMimeType::QMimeType(const QMimeTypePrivate &dd) :
+        d(new QMimeTypePrivate(dd))
+{
+    DBG() << "name():" << d->name;
+}
+
+/*!
+    \fn void QMimeType::swap(QMimeType &other);
+    Swaps QMimeType \a other with this QMimeType object.
+
+    This operation is very fast and never fails.
+
+    The swap() method helps with the implementation of assignment
+    operators in an exception-safe way. For more information consult
+    \l {http://en.wikibooks.org/wiki/More_C++_Idioms/Copy-and-swap}
+    {More C++ Idioms - Copy-and-swap}.
+ */
+
+/*!
+    \fn QMimeType::~QMimeType();
+    Destroys the QMimeType object, and releases the d pointer.
+ */
+QMimeType::~QMimeType()
+{
+    DBG() << "name():" << d->name;
+}
+
+/*!
+    \fn bool QMimeType::operator==(const QMimeType &other) const;
+    Returns true if \a other equals this QMimeType object, otherwise returns false.
+ */
+bool QMimeType::operator==(const QMimeType &other) const
+{
+    return d == other.d || *d == *other.d;
+}
+
+/*!
+    \fn bool QMimeType::operator!=(const QMimeType &other) const;
+    Returns true if \a other does not equal this QMimeType object, otherwise returns false.
+ */
+
+/*!
+    \fn bool QMimeType::isValid() const;
+    Returns true if the QMimeType object contains valid data, otherwise returns false.
+    A valid MIME type has a non-empty name().
+    The invalid MIME type is the default-constructed QMimeType.
+ */
+bool QMimeType::isValid() const
+{
+    return !d->name.isEmpty();
+}
+
+/*!
+    \fn QString QMimeType::name() const;
+    Returns the name of the MIME type.
+ */
+QString QMimeType::name() const
+{
+    return d->name;
+}
+
+#undef DBG
+
+QT_END_NAMESPACE
@@ -0,0 +1,182 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtCore module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qmimewatcher_p.h"
+
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+
+#if defined(Q_OS_LINUX)
+#include <sys/inotify.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#define QMIME_USE_INOTIFY
+#endif
+
+QT_BEGIN_NAMESPACE
+
+QMimeDirectoryWatcher::QMimeDirectoryWatcher()
+    : m_inotifyFd(-1), m_changed(0), m_watching(0)
+{
+    m_wakeUpPipe[0] = m_wakeUpPipe[1] = -1;
+}
+
+QMimeDirectoryWatcher::~QMimeDirectoryWatcher()
+{
+#ifdef QMIME_USE_INOTIFY
+    if (m_inotifyFd == -1)
+        return;
+    // Wake up the thread, which then exits
+    const char c = 0;
+    while (::write(m_wakeUpPipe[1], &c, 1) == -1 && errno == EINTR) {}
+    wait();
+    ::close(m_wakeUpPipe[0]);
+    ::close(m_wakeUpPipe[1]);
+    ::close(m_inotifyFd);
+#endif
+}
+
+/*!
+    \internal
+    Starts watching the "mime" and "mime/packages" directories of \a dataDirs.
+    Returns false if they cannot be watched on this system.
+*/
+bool QMimeDirectoryWatcher::watch(const QStringList &dataDirs)
+{
+#ifdef QMIME_USE_INOTIFY
+    Q_ASSERT(m_inotifyFd == -1); // this method is only ever called once
+    if (!qgetenv("QT_NO_MIME_INOTIFY").isEmpty())
+        return false;
+
+    m_inotifyFd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotifyFd == -1)
+        return false;
+    if (::pipe(m_wakeUpPipe) == -1) {
+        ::close(m_inotifyFd);
+        m_inotifyFd = -1;
+        return false;
+    }
+
+    m_dataDirs = dataDirs;
+    addWatches();
+    m_watching = 1;
+    start();
+    return true;
+#else
+    Q_UNUSED(dataDirs);
+    return false;
+#endif
+}
+
+#ifdef QMIME_USE_INOTIFY
+static bool addWatch(int inotifyFd, const QString &path, uint mask)
+{
+    return ::inotify_add_watch(inotifyFd, QFile::encodeName(path).constData(), mask) != -1;
+}
+#endif
+
+/*!
+    \internal
+    Adds the watches, again after each change since the directories may have
+    been created meanwhile. Watching an already watched directory does nothing.
+*/
+void QMimeDirectoryWatcher::addWatches()
+{
+#ifdef QMIME_USE_INOTIFY
+    // mime.cache and the other files written by update-mime-database, or the package files
+    const uint contentsMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+            | IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF;
+
+    foreach (const QString &dataDir, m_dataDirs) {
+        const QString mimeDir = dataDir + QLatin1String("/mime");
+        if (!addWatch(m_inotifyFd, mimeDir, contentsMask)) {
+            // Not created yet: watch the closest existing parent, to notice when it is
+            QString dir = mimeDir;
+            for (;;) {
+                const QString parentDir = QFileInfo(dir).absolutePath();
+                if (parentDir == dir || addWatch(m_inotifyFd, parentDir, IN_CREATE | IN_MOVED_TO))
+                    break;
+                dir = parentDir;
+            }
+            continue;
+        }
+        addWatch(m_inotifyFd, mimeDir + QLatin1String("/packages"), contentsMask);
+    }
+#endif
+}
+
+void QMimeDirectoryWatcher::run()
+{
+#ifdef QMIME_USE_INOTIFY
+    struct pollfd fds[2];
+    fds[0].fd = m_inotifyFd;
+    fds[0].events = POLLIN;
+    fds[1].fd = m_wakeUpPipe[0];
+    fds[1].events = POLLIN;
+
+    char buffer[4096];
+    for (;;) {
+        fds[0].revents = fds[1].revents = 0;
+        if (::poll(fds, 2, -1) == -1) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (fds[1].revents)
+            return;
+        if (fds[0].revents) {
+            // Which files changed doesn't matter, the database checks them all anyway
+            while (::read(m_inotifyFd, buffer, sizeof(buffer)) > 0) {}
+            addWatches();
+            m_changed.fetchAndStoreOrdered(1);
+        }
+    }
+
+    qWarning("QMimeDatabase: Cannot watch the mime directories: %s", qPrintable(qt_error_string(errno)));
+    // Back to polling
+    m_watching = 0;
+    m_changed.fetchAndStoreOrdered(1);
+#endif
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,88 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtCore module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QMIMEWATCHER_P_H
+#define QMIMEWATCHER_P_H
+
+#include "qmime_global.h"
+
+#include <QtCore/qatomic.h>
+#include <QtCore/qstringlist.h>
+#include <QtCore/qthread.h>
+
+QT_BEGIN_NAMESPACE
+
+/*
+   Watches the mime directories of the XDG data dirs from a thread of its own,
+   and records that something changed in them, so that the database only looks
+   at its files again after an actual change.
+   Needs inotify (Linux): elsewhere, or if QT_NO_MIME_INOTIFY is set, watch()
+   returns false and the database keeps polling.
+ */
+class QMimeDirectoryWatcher : public QThread
+{
+public:
+    QMimeDirectoryWatcher();
+    ~QMimeDirectoryWatcher();
+
+    bool watch(const QStringList &dataDirs);
+    inline bool isWatching() const { return m_watching != 0; }
+
+    // Returns true, only once, if something changed since the previous call
+    inline bool testAndClearChanged()
+    { return m_changed != 0 && m_changed.testAndSetOrdered(1, 0); }
+
+protected:
+    void run();
+
+private:
+    void addWatches();
+
+    QStringList m_dataDirs;
+    int m_inotifyFd;
+    int m_wakeUpPipe[2];
+    QAtomicInt m_changed;
+    QAtomicInt m_watching;
+};
+
+QT_END_NAMESPACE
+
+#endif // QMIMEWATCHER_P_H
@@ -0,0 +1,181 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtCore module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qmimexmlpackage_p.h"
+
+#include "qmimetype_p.h"
+
+#include <QtCore/QDataStream>
+
+QT_BEGIN_NAMESPACE
+
+static const quint32 packageMagic = 0x514d5853; // "QMXS"
+static const quint32 packageVersion = 2;
+
+static void writeMagicRules(QDataStream &out, const QList<QMimeMagicRule> &rules)
+{
+    out << quint32(rules.count());
+    foreach (const QMimeMagicRule &rule, rules) {
+        out << quint8(rule.type()) << rule.value() << qint32(rule.startPos()) << qint32(rule.endPos()) << rule.mask();
+        writeMagicRules(out, rule.m_subMatches);
+    }
+}
+
+static bool readMagicRules(QDataStream &in, QList<QMimeMagicRule> &rules)
+{
+    quint32 count;
+    in >> count;
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        quint8 type;
+        QByteArray value;
+        qint32 startPos;
+        qint32 endPos;
+        QByteArray mask;
+        in >> type >> value >> startPos >> endPos >> mask;
+        // The rule asserts on what the parser rejects
+        if (in.status() != QDataStream::Ok || type == QMimeMagicRule::Invalid || type > QMimeMagicRule::Byte || value.isEmpty())
+            return false;
+        QMimeMagicRule rule(QMimeMagicRule::Type(type), value, startPos, endPos, mask);
+        if (!readMagicRules(in, rule.m_subMatches))
+            return false;
+        rules.append(rule);
+    }
+    return in.status() == QDataStream::Ok;
+}
+
+/*!
+    \internal
+    Writes the package to \a device, tagged with \a key: the files it was parsed from,
+    or nothing for the built-in database.
+*/
+bool QMimeXMLPackage::write(QIODevice *device, const QByteArray &key) const
+{
+    QDataStream out(device);
+    out.setVersion(QDataStream::Qt_4_6);
+
+    out << packageMagic << packageVersion << key;
+
+    out << quint32(mimeTypes.count());
+    foreach (const QMimeType &mt, mimeTypes) {
+        const QMimeTypePrivate data(mt);
+        out << data.name << data.localeComments << data.genericIconName << data.iconName << data.globPatterns;
+    }
+
+    out << quint32(globs.count());
+    foreach (const QMimeGlobPattern &glob, globs)
+        out << glob.pattern() << glob.mimeType() << quint32(glob.weight()) << glob.isCaseSensitive();
+
+    out << parents << aliases;
+
+    out << quint32(magicMatchers.count());
+    foreach (const QMimeMagicRuleMatcher &matcher, magicMatchers) {
+        out << matcher.mimetype() << quint32(matcher.priority());
+        writeMagicRules(out, matcher.magicRules());
+    }
+    return out.status() == QDataStream::Ok;
+}
+
+/*!
+    \internal
+    Reads what write() wrote to \a device. Returns false, without changing anything,
+    if the data is invalid or doesn't match \a key.
+*/
+bool QMimeXMLPackage::read(QIODevice *device, const QByteArray &key)
+{
+    QDataStream in(device);
+    in.setVersion(QDataStream::Qt_4_6);
+
+    quint32 magic;
+    quint32 version;
+    QByteArray fileKey;
+    in >> magic >> version;
+    if (in.status() != QDataStream::Ok || magic != packageMagic || version != packageVersion)
+        return false;
+    in >> fileKey;
+    if (fileKey != key)
+        return false;
+
+    QMimeXMLPackage package;
+    quint32 count;
+    in >> count;
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        QMimeTypePrivate data;
+        in >> data.name >> data.localeComments >> data.genericIconName >> data.iconName >> data.globPatterns;
+        package.mimeTypes.append(QMimeType(data));
+    }
+
+    in >> count;
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        QString pattern;
+        QString mimeType;
+        quint32 weight;
+        bool caseSensitive;
+        in >> pattern >> mimeType >> weight >> caseSensitive;
+        package.globs.append(QMimeGlobPattern(pattern, mimeType, weight, caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive));
+    }
+
+    in >> package.parents >> package.aliases;
+
+    in >> count;
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        QString mimeType;
+        quint32 priority;
+        QList<QMimeMagicRule> rules;
+        in >> mimeType >> priority;
+        if (!readMagicRules(in, rules))
+            return false;
+        QMimeMagicRuleMatcher matcher(mimeType, priority);
+        matcher.addRules(rules);
+        package.magicMatchers.append(matcher);
+    }
+    if (in.status() != QDataStream::Ok)
+        return false;
+
+    mimeTypes = package.mimeTypes;
+    globs = package.globs;
+    parents = package.parents;
+    aliases = package.aliases;
+    magicMatchers = package.magicMatchers;
+    ok = true;
+    return true;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,86 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtCore module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QMIMEXMLPACKAGE_P_H
+#define QMIMEXMLPACKAGE_P_H
+
+#include "qmimeglobpattern_p.h"
+#include "qmimemagicrulematcher_p.h"
+#include "qmimetype.h"
+
+#include <QtCore/qlist.h>
+#include <QtCore/qpair.h>
+#include <QtCore/qstring.h>
+
+QT_BEGIN_NAMESPACE
+
+class QIODevice;
+
+/*
+   What one XML package file contains, in the order of the file: package files are
+   parsed in parallel into these, then added to the provider one after the other.
+
+   The serialized form is the XML provider's snapshot, and the built-in database
+   that qmimedatabasegen generates from freedesktop.org.xml. It only depends on
+   the parser, so that qmimedatabasegen doesn't need the rest of the library.
+ */
+struct QMimeXMLPackage
+{
+    QMimeXMLPackage() : ok(false) {}
+    explicit QMimeXMLPackage(const QString &file) : fileName(file), ok(false) {}
+
+    bool write(QIODevice *device, const QByteArray &key) const;
+    bool read(QIODevice *device, const QByteArray &key);
+
+    QString fileName;
+    bool ok;
+    QString errorMessage;
+
+    QList<QMimeType> mimeTypes;
+    QList<QMimeGlobPattern> globs;
+    QList<QPair<QString, QString> > parents;
+    QList<QPair<QString, QString> > aliases;
+    QList<QMimeMagicRuleMatcher> magicMatchers;
+};
+
+QT_END_NAMESPACE
+
+#endif // QMIMEXMLPACKAGE_P_H
@@ -1,3 +1,4 @@
 TEMPLATE = subdirs
 CONFIG += ordered
 SUBDIRS += mimetypes
+!qmime_no_builtin_database:isEmpty(QMIME_DATABASEGEN): SUBDIRS = tools/qmimeparser tools/qmimedatabasegen $$SUBDIRS
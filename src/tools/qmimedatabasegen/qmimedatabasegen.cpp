@@ -0,0 +1,114 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtCore module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+// Serializes freedesktop.org.xml into the built-in database of the library, so
+// that the XML provider reads it back instead of parsing the XML at runtime.
+// Only needs the parser sources, built into a static library (see src/tools).
+// Usage: qmimedatabasegen <freedesktop.org.xml> <output.cpp>
+
+#include "qmimetypeparser_p.h"
+
+#include <QtCore/QBuffer>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QFile>
+#include <QtCore/QStringList>
+
+#include <stdio.h>
+
+QT_USE_NAMESPACE
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const QStringList args = app.arguments();
+    if (args.count() != 3) {
+        fprintf(stderr, "Usage: %s <freedesktop.org.xml> <output.cpp>\n", qPrintable(args.at(0)));
+        return 1;
+    }
+
+    QFile in(args.at(1));
+    if (!in.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        fprintf(stderr, "%s: Cannot open %s: %s\n", qPrintable(args.at(0)), qPrintable(args.at(1)), qPrintable(in.errorString()));
+        return 1;
+    }
+
+    QMimeXMLPackage package(args.at(1));
+    QMimePackageParser parser(package);
+    if (!parser.parse(&in, args.at(1), &package.errorMessage)) {
+        fprintf(stderr, "%s: %s\n", qPrintable(args.at(0)), qPrintable(package.errorMessage));
+        return 1;
+    }
+
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    if (!package.write(&buffer, QByteArray())) {
+        fprintf(stderr, "%s: Cannot serialize %s\n", qPrintable(args.at(0)), qPrintable(args.at(1)));
+        return 1;
+    }
+    const QByteArray data = buffer.data();
+
+    QFile out(args.at(2));
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        fprintf(stderr, "%s: Cannot write %s: %s\n", qPrintable(args.at(0)), qPrintable(args.at(2)), qPrintable(out.errorString()));
+        return 1;
+    }
+
+    QByteArray source;
+    source += "// freedesktop.org.xml serialized by qmimedatabasegen, do not edit.\n\n";
+    source += "#include <QtCore/qglobal.h>\n\n";
+    source += "QT_BEGIN_NAMESPACE\n\n";
+    source += "extern const unsigned char qmime_builtin_database[] = {\n";
+    for (int i = 0; i < data.size(); ++i) {
+        source += (i % 16 == 0) ? "    " : " ";
+        source += "0x" + QByteArray::number(uchar(data.at(i)), 16).rightJustified(2, '0') + ',';
+        if (i % 16 == 15 || i == data.size() - 1)
+            source += '\n';
+    }
+    source += "};\n\n";
+    source += "extern const int qmime_builtin_database_size = " + QByteArray::number(data.size()) + ";\n\n";
+    source += "QT_END_NAMESPACE\n";
+
+    if (out.write(source) != source.size()) {
+        fprintf(stderr, "%s: Cannot write %s: %s\n", qPrintable(args.at(0)), qPrintable(args.at(2)), qPrintable(out.errorString()));
+        return 1;
+    }
+    return 0;
+}
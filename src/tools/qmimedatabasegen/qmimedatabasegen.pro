@@ -0,0 +1,24 @@
+include(../../../mimetypes-nolibs.pri)
+
+# Host tool serializing freedesktop.org.xml into the built-in database of the
+# library, see mimetypes.pro. Linked with the parser sources only (qmimeparser).
+# When cross-compiling, build it for the host and pass QMIME_DATABASEGEN instead.
+
+TARGET = qmimedatabasegen
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+DESTDIR = ../../../bin
+
+DEFINES += QMIME_LIBRARY
+
+QT     = core
+
+QMAKE_CXXFLAGS += -W -Wall -Wextra -Wshadow -Wnon-virtual-dtor
+
+SOURCES += qmimedatabasegen.cpp
+
+QMIMEPARSER_DIR = $$OUT_PWD/../qmimeparser
+LIBS += -L$$QMIMEPARSER_DIR -lqmimeparser
+win32-msvc*: PRE_TARGETDEPS += $$QMIMEPARSER_DIR/qmimeparser.lib
+else: PRE_TARGETDEPS += $$QMIMEPARSER_DIR/libqmimeparser.a
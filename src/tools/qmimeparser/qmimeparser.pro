@@ -0,0 +1,33 @@
+include(../../../mimetypes-nolibs.pri)
+
+# The parser sources, and the serialized form of what they parse, for qmimedatabasegen.
+# They don't depend on the rest of the library.
+
+TARGET = qmimeparser
+TEMPLATE = lib
+CONFIG += staticlib
+win32: DESTDIR = ./
+
+DEFINES += QMIME_LIBRARY
+
+QT     = core
+
+QMAKE_CXXFLAGS += -W -Wall -Wextra -Wshadow -Wnon-virtual-dtor
+
+MIMETYPES = ../../mimetypes
+
+SOURCES += $$MIMETYPES/qmimetypeparser.cpp \
+           $$MIMETYPES/qmimetypeprivate.cpp \
+           $$MIMETYPES/qmimexmlpackage.cpp \
+           $$MIMETYPES/qmimeglobpattern.cpp \
+           $$MIMETYPES/qmimemagicrule.cpp \
+           $$MIMETYPES/qmimemagicrulematcher.cpp \
+           $$MIMETYPES/qmimemagicsubstring.cpp
+
+HEADERS += $$MIMETYPES/qmimetypeparser_p.h \
+           $$MIMETYPES/qmimetype_p.h \
+           $$MIMETYPES/qmimexmlpackage_p.h \
+           $$MIMETYPES/qmimeglobpattern_p.h \
+           $$MIMETYPES/qmimemagicrule_p.h \
+           $$MIMETYPES/qmimemagicrulematcher_p.h \
+           $$MIMETYPES/qmimemagicsubstring_p.h
@@ -2,4 +2,6 @@ TEMPLATE = subdirs
 
 SUBDIRS += \
     qmimetype \
+    qmimemagicrule \
+    qmimeglobpattern \
     qmimedatabase \
@@ -1,5 +1,5 @@
 TEMPLATE = subdirs
 SUBDIRS = qmimedatabase-xml
-unix: SUBDIRS += qmimedatabase-cache
+unix: SUBDIRS += qmimedatabase-cache qmimedatabase-generated
 
 OTHER_FILES = testfiles/list
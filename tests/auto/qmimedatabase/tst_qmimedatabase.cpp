@@ -40,6 +40,7 @@
 ****************************************************************************/
 
 #include <qmimedatabase.h>
+#include <qmimedatasniffer.h>
 
 #include "qstandardpaths.h"
 
@@ -88,6 +89,7 @@ static inline QString testSuiteWarning()
 Q_CONSTRUCTOR_FUNCTION(initializeLang)
 
 tst_QMimeDatabase::tst_QMimeDatabase()
+    : m_maxThreadCount(QThreadPool::globalInstance()->maxThreadCount())
 {
 }
 
@@ -120,6 +122,8 @@ void tst_QMimeDatabase::initTestCase()
 
     qputenv("XDG_DATA_DIRS", QFile::encodeName(m_globalXdgDir));
     qputenv("XDG_DATA_HOME", QFile::encodeName(m_localXdgDir));
+    // Keep the XML provider's snapshots out of the user's cache
+    qputenv("XDG_CACHE_HOME", QFile::encodeName(m_temporaryDir.path() + QLatin1String("/cache")));
     qDebug() << "\nLocal XDG_DATA_HOME: " << m_localXdgDir
              << "\nGlobal XDG_DATA_DIRS: " << m_globalXdgDir;
 
@@ -289,6 +293,43 @@ void tst_QMimeDatabase::mimeTypesForFileName()
     QCOMPARE(mimeNames, expectedMimeTypes);
 }
 
+void tst_QMimeDatabase::mimeTypesForFileNames()
+{
+    QStringList fileNames;
+    fileNames << QLatin1String("textfile.txt") << QLatin1String("textfile.TxT") << QLatin1String("textfile.C")
+              << QLatin1String("textfile.c") << QLatin1String("core") << QLatin1String("Core")
+              << QLatin1String("foo.tar.bz2") << QLatin1String("/some/dir/README.foo") << QLatin1String("/")
+              << QLatin1String("foo.doc") << QLatin1String("foo.unknownextension") << QString()
+              << QLatin1String("foo.txt");
+
+    QMimeDatabase db;
+    const QVector<QMimeType> mimes = db.mimeTypesForFileNames(fileNames);
+    QCOMPARE(mimes.count(), fileNames.count());
+    for (int i = 0; i < fileNames.count(); ++i)
+        QCOMPARE(mimes.at(i).name(), db.mimeTypeForFile(fileNames.at(i), QMimeDatabase::MatchExtension).name());
+
+    QVERIFY(db.mimeTypesForFileNames(QStringList()).isEmpty());
+}
+
+void tst_QMimeDatabase::mimeTypesForFileNamesPerformance()
+{
+    // A directory listing of 100k entries
+    QStringList extensions;
+    extensions << QLatin1String(".txt") << QLatin1String(".tar.bz2") << QLatin1String(".JPG") << QLatin1String(".cpp")
+               << QLatin1String(".unknownextension") << QLatin1String("") << QLatin1String(".html") << QLatin1String("~");
+    QStringList fileNames;
+    for (int i = 0; i < 100000; ++i)
+        fileNames.append(QLatin1String("/home/user/files/file-") + QString::number(i) + extensions.at(i % extensions.count()));
+
+    QMimeDatabase db;
+    QVector<QMimeType> mimes;
+    QBENCHMARK {
+        mimes = db.mimeTypesForFileNames(fileNames);
+    }
+    QCOMPARE(mimes.count(), fileNames.count());
+    QCOMPARE(mimes.at(0).name(), QString::fromLatin1("text/plain"));
+}
+
 void tst_QMimeDatabase::inheritance()
 {
     QMimeDatabase db;
@@ -355,6 +396,25 @@ void tst_QMimeDatabase::inheritance()
     QVERIFY(mswordTemplate.inherits(QLatin1String("application/msword")));
 }
 
+void tst_QMimeDatabase::inheritsAllAncestors()
+{
+    // inherits() uses precomputed ancestors, allAncestors() walks the parents
+    QMimeDatabase db;
+    QStringList probes;
+    probes << QLatin1String("text/plain") << QLatin1String("application/xml")
+           << QLatin1String("application/zip") << QLatin1String("inode/directory")
+           << QLatin1String("application/octet-stream") << QLatin1String("application/x-pdf");
+    foreach (const QMimeType &mime, db.allMimeTypes()) {
+        const QStringList ancestors = mime.allAncestors();
+        foreach (const QString &ancestor, ancestors)
+            QVERIFY2(mime.inherits(ancestor), qPrintable(mime.name() + QLatin1String(" -> ") + ancestor));
+        foreach (const QString &probe, probes) {
+            const QString resolvedProbe = db.mimeTypeForName(probe).name();
+            QCOMPARE(mime.inherits(probe), mime.name() == resolvedProbe || ancestors.contains(resolvedProbe));
+        }
+    }
+}
+
 void tst_QMimeDatabase::aliases()
 {
     QMimeDatabase db;
@@ -474,6 +534,7 @@ void tst_QMimeDatabase::mimeTypeForData()
 
     QMimeDatabase db;
     QCOMPARE(db.mimeTypeForData(data).name(), expectedMimeTypeName);
+    QCOMPARE(db.mimeTypeForData(data.constData(), data.size()).name(), expectedMimeTypeName);
     QBuffer buffer(&data);
     QCOMPARE(db.mimeTypeForData(&buffer).name(), expectedMimeTypeName);
     QVERIFY(!buffer.isOpen()); // initial state was restored
@@ -573,6 +634,29 @@ void tst_QMimeDatabase::inheritsPerformance()
     // parsing XML, and then keeps being around 4.5 MB for all the in-memory hashes.
 }
 
+void tst_QMimeDatabase::allAncestorsPerformance()
+{
+    QMimeDatabase db;
+    const QMimeType mime = db.mimeTypeForName(QString::fromLatin1("application/x-shellscript"));
+    QVERIFY(mime.isValid());
+    QBENCHMARK {
+        for (int i = 0; i < 40; ++i)
+            QCOMPARE(mime.allAncestors().last(), QString::fromLatin1("application/octet-stream"));
+    }
+}
+
+void tst_QMimeDatabase::commentPerformance()
+{
+    // The comment of a type is read from disk once, not again for each QMimeType returned
+    QMimeDatabase db;
+    const QString comment = db.mimeTypeForName(QString::fromLatin1("text/plain")).comment();
+    QVERIFY(!comment.isEmpty());
+    QBENCHMARK {
+        for (int i = 0; i < 100; ++i)
+            QCOMPARE(db.mimeTypeForFile(QString::fromLatin1("file.txt"), QMimeDatabase::MatchExtension).comment(), comment);
+    }
+}
+
 void tst_QMimeDatabase::suffixes_data()
 {
     QTest::addColumn<QString>("mimeType");
@@ -741,6 +825,45 @@ void tst_QMimeDatabase::findByData()
     QCOMPARE(mimeForInfo, resultMimeTypeName);
 }
 
+void tst_QMimeDatabase::findByDataSniffer_data()
+{
+    findByFileName_data();
+}
+
+void tst_QMimeDatabase::findByDataSniffer()
+{
+    QFETCH(QString, filePath);
+
+    QMimeDatabase database;
+    QFile f(filePath);
+    QVERIFY(f.open(QIODevice::ReadOnly));
+    const QByteArray data = f.read(16384);
+    const QString expected = database.mimeTypeForData(data).name();
+
+    // Feed the file in small chunks, as it would arrive from the network
+    QMimeDataSniffer sniffer(database);
+    QCOMPARE(sniffer.status(), QMimeDataSniffer::NeedMoreData);
+    QVERIFY(sniffer.bytesNeeded() > 0);
+    int pos = 0;
+    while (pos < data.size() && sniffer.status() == QMimeDataSniffer::NeedMoreData) {
+        const QByteArray chunk = data.mid(pos, 64);
+        pos += chunk.size();
+        sniffer.addData(chunk);
+    }
+    if (sniffer.finish() == QMimeDataSniffer::Finished)
+        QCOMPARE(pos, data.size());
+    QCOMPARE(sniffer.mimeType().name(), expected);
+    QCOMPARE(sniffer.bytesNeeded(), qint64(0));
+
+    // Once decided, the result must not depend on the bytes after the decision
+    if (sniffer.status() == QMimeDataSniffer::Decided)
+        QCOMPARE(database.mimeTypeForData(data.left(pos)).name(), expected);
+
+    sniffer.reset();
+    QCOMPARE(sniffer.status(), QMimeDataSniffer::NeedMoreData);
+    QCOMPARE(sniffer.bytesReceived(), qint64(0));
+}
+
 void tst_QMimeDatabase::findByFile_data()
 {
     findByFileName_data();
@@ -770,6 +893,75 @@ void tst_QMimeDatabase::findByFile()
     QCOMPARE(mimeForFileInfo.name(), resultMimeTypeName);
 }
 
+QT_BEGIN_NAMESPACE
+extern QMIME_EXPORT QString qmime_mimeTypeForMagic(const QByteArray &data, bool useDispatchIndex,
+                                                   int *matcherCount, int *matchersEvaluated, int *rulesEvaluated); // see qmimedatabase.cpp
+QT_END_NAMESPACE
+
+void tst_QMimeDatabase::magicDispatchIndex()
+{
+    if (m_testSuite.isEmpty())
+        QSKIP("shared-mime-info test suite not available.", SkipSingle);
+
+    QList<QByteArray> contents;
+    QDir testDir(m_testSuite);
+    foreach (const QString &fileName, testDir.entryList(QDir::Files)) {
+        QFile f(testDir.filePath(fileName));
+        QVERIFY(f.open(QIODevice::ReadOnly));
+        contents.append(f.read(16384));
+    }
+    QVERIFY(!contents.isEmpty());
+
+    QStringList expected;
+    int rulesWithoutIndex = 0;
+    int matchedFiles = 0;
+    int matchersForMatchedFiles = 0;
+    int matcherCount = 0;
+    foreach (const QByteArray &data, contents) {
+        int matchers = 0;
+        int rules = 0;
+        const QString name = qmime_mimeTypeForMagic(data, false, &matcherCount, &matchers, &rules);
+        expected.append(name);
+        rulesWithoutIndex += rules;
+        QVERIFY(matchers <= matcherCount);
+        if (!name.isEmpty()) {
+            // Tried by decreasing priority, up to the first match
+            ++matchedFiles;
+            matchersForMatchedFiles += matchers;
+        }
+    }
+    QVERIFY(matcherCount > 0);
+    QVERIFY(matchedFiles > 0);
+    QVERIFY(matchersForMatchedFiles < matchedFiles * matcherCount);
+
+    QStringList actual;
+    int rulesWithIndex = 0;
+    int matchersWithIndex = 0;
+    foreach (const QByteArray &data, contents) {
+        int matchers = 0;
+        int rules = 0;
+        actual.append(qmime_mimeTypeForMagic(data, true, &matcherCount, &matchers, &rules));
+        rulesWithIndex += rules;
+        matchersWithIndex += matchers;
+        QVERIFY(matchers < matcherCount);
+    }
+
+    QCOMPARE(actual, expected);
+    qDebug() << "Magic rules evaluated per file:" << double(rulesWithoutIndex) / contents.count()
+             << "without index," << double(rulesWithIndex) / contents.count() << "with index";
+    qDebug() << "Magic matchers evaluated per file:" << double(matchersForMatchedFiles) / matchedFiles
+             << "of" << matcherCount << "without index, for the files matched";
+    qDebug() << "Magic matchers evaluated per file:" << double(matchersWithIndex) / contents.count()
+             << "of" << matcherCount << "with index";
+    QVERIFY(rulesWithIndex < rulesWithoutIndex);
+
+    QMimeDatabase db;
+    QBENCHMARK {
+        foreach (const QByteArray &data, contents)
+            db.mimeTypeForData(data);
+    }
+}
+
 
 void tst_QMimeDatabase::fromThreads()
 {
@@ -788,8 +980,61 @@ void tst_QMimeDatabase::fromThreads()
         f.waitForFinished();
 }
 
+// The lookups of a typical file manager, all using the same snapshot of the database
+static bool lookupsFromThread()
+{
+    QMimeDatabase db;
+    bool ok = true;
+    for (int i = 0; i < 200; ++i) {
+        ok &= db.mimeTypeForFile(QString::fromLatin1("file%1.txt").arg(i), QMimeDatabase::MatchExtension).name() == QLatin1String("text/plain");
+        ok &= db.mimeTypeForFile(QString::fromLatin1("image%1.png").arg(i), QMimeDatabase::MatchExtension).name() == QLatin1String("image/png");
+        ok &= db.mimeTypeForName(QString::fromLatin1("application/x-pdf")).name() == QLatin1String("application/pdf");
+        ok &= db.mimeTypeForData(QByteArray("%PDF-1.4")).inherits(QString::fromLatin1("application/pdf"));
+    }
+    return ok;
+}
+
+void tst_QMimeDatabase::fromThreadsBenchmark_data()
+{
+    QTest::addColumn<int>("threadCount");
+    QTest::newRow("1 thread") << 1;
+    QTest::newRow("2 threads") << 2;
+    QTest::newRow("4 threads") << 4;
+    QTest::newRow("8 threads") << 8;
+}
+
+void tst_QMimeDatabase::fromThreadsBenchmark()
+{
+    // Each thread does the same lookups: as long as the threads don't have to
+    // wait for each other, the time doesn't grow with their number (up to the
+    // number of cores)
+    QFETCH(int, threadCount);
+    QThreadPool::globalInstance()->setMaxThreadCount(threadCount);
+    QBENCHMARK {
+        QList<QFuture<bool> > futures;
+        for (int i = 0; i < threadCount; ++i)
+            futures << QtConcurrent::run(lookupsFromThread);
+        Q_FOREACH (QFuture<bool> f, futures)
+            QVERIFY(f.result());
+    }
+}
+
+#ifdef QMIME_BUILTIN_UPDATE_MIME_DATABASE
+QT_BEGIN_NAMESPACE
+QMIME_EXPORT bool qmime_updateMimeDatabase(const QString &mimeDir, QString *errorMessage); // see qmimecachewriter.cpp
+QT_END_NAMESPACE
+#endif
+
 static bool runUpdateMimeDatabase(const QString &path) // TODO make it a QMimeDatabase method?
 {
+#ifdef QMIME_BUILTIN_UPDATE_MIME_DATABASE
+    QString errorMessage;
+    if (!qmime_updateMimeDatabase(path, &errorMessage)) {
+        qWarning("Cannot update %s: %s", qPrintable(path), qPrintable(errorMessage));
+        return false;
+    }
+    return true;
+#else
     const QString umdCommand = QString::fromLatin1("update-mime-database");
     const QString umd = QStandardPaths::findExecutable(umdCommand);
     if (umd.isEmpty()) {
@@ -808,6 +1053,7 @@ static bool runUpdateMimeDatabase(const QString &path) // TODO make it a QMimeDa
     proc.waitForFinished();
     //qDebug() << "runUpdateMimeDatabase" << path;
     return true;
+#endif
 }
 
 static bool waitAndRunUpdateMimeDatabase(const QString &path)
@@ -838,9 +1084,19 @@ static void checkHasMimeType(const QString &mimeType)
 }
 
 QT_BEGIN_NAMESPACE
-extern QMIME_EXPORT int qmime_secondsBetweenChecks; // see qmimeprovider.cpp
+extern QMIME_EXPORT int qmime_secondsBetweenChecks; // see qmimedatabase.cpp
+extern QMIME_EXPORT int qmime_xmlSnapshotsLoaded; // see qmimeprovider.cpp
+extern QMIME_EXPORT int qmime_generatedCachesLoaded; // see qmimedatabase.cpp
 QT_END_NAMESPACE
 
+void tst_QMimeDatabase::cleanup()
+{
+    // Back to the default of qmimedatabase.cpp, even after a failed or skipped test
+    qmime_secondsBetweenChecks = 5;
+    // The threads tests change it, packagesOverrideInOrder parses in parallel
+    QThreadPool::globalInstance()->setMaxThreadCount(m_maxThreadCount);
+}
+
 void tst_QMimeDatabase::installNewGlobalMimeType()
 {
     qmime_secondsBetweenChecks = 0;
@@ -913,6 +1169,212 @@ void tst_QMimeDatabase::installNewLocalMimeType()
     QVERIFY(!db.mimeTypeForName(QLatin1String("text/x-suse-ymp")).isValid());
 }
 
+void tst_QMimeDatabase::watchMimeDirectories()
+{
+#ifndef Q_OS_LINUX
+    QSKIP("The mime directories are only watched with inotify", SkipAll);
+#endif
+    if (!qgetenv("QT_NO_MIME_INOTIFY").isEmpty())
+        QSKIP("QT_NO_MIME_INOTIFY is set", SkipAll);
+
+    // Changes must be noticed without polling
+    qmime_secondsBetweenChecks = 3600;
+
+    QMimeDatabase db;
+    QVERIFY(!db.mimeTypeForName(QLatin1String("text/x-suse-ymp")).isValid());
+
+    const QString mimeDir = m_localXdgDir + QLatin1String("/mime");
+    const QString destFile = mimeDir + QLatin1String("/packages/") + QLatin1String(yastFileName);
+    QVERIFY(QFile::copy(m_yastMimeTypes, destFile));
+    if (!waitAndRunUpdateMimeDatabase(mimeDir))
+        QSKIP("shared-mime-info not found, skipping mime.cache test", SkipSingle);
+    // The watcher thread needs a moment to see the change
+    for (int i = 0; i < 50 && !db.mimeTypeForName(QLatin1String("text/x-suse-ymp")).isValid(); ++i)
+        QTest::qSleep(100);
+    QVERIFY(db.mimeTypeForName(QLatin1String("text/x-suse-ymp")).isValid());
+
+    QFile::remove(destFile);
+    if (!waitAndRunUpdateMimeDatabase(mimeDir))
+        QSKIP("shared-mime-info not found, skipping mime.cache test", SkipSingle);
+    for (int i = 0; i < 50 && db.mimeTypeForName(QLatin1String("text/x-suse-ymp")).isValid(); ++i)
+        QTest::qSleep(100);
+    QVERIFY(!db.mimeTypeForName(QLatin1String("text/x-suse-ymp")).isValid());
+}
+
+void tst_QMimeDatabase::xmlSnapshot()
+{
+    if (qgetenv("QT_NO_MIME_CACHE").isEmpty())
+        QSKIP("The snapshot is only used by the XML provider", SkipAll);
+
+    qmime_secondsBetweenChecks = 0;
+
+    QMimeDatabase db;
+    const QString destDir = m_localXdgDir + QLatin1String("/mime/packages/");
+    QDir().mkpath(destDir);
+    const QString destFile = destDir + QLatin1String(yastFileName);
+    const QString movedFile = m_temporaryDir.path() + QLatin1Char('/') + QLatin1String(yastFileName);
+    QFile::remove(destFile);
+    QFile::remove(movedFile);
+
+    // Parsed, and saved for next time
+    QVERIFY(QFile::copy(m_yastMimeTypes, destFile));
+    QVERIFY(db.mimeTypeForName(QLatin1String("text/x-suse-ymp")).isValid());
+
+    QVERIFY(QFile::rename(destFile, movedFile));
+    QVERIFY(!db.mimeTypeForName(QLatin1String("text/x-suse-ymp")).isValid());
+    const int snapshotsLoaded = qmime_xmlSnapshotsLoaded;
+
+    // Same files as before: no parsing needed
+    QVERIFY(QFile::rename(movedFile, destFile));
+    QVERIFY(db.mimeTypeForName(QLatin1String("text/x-suse-ymp")).isValid());
+    QCOMPARE(qmime_xmlSnapshotsLoaded, snapshotsLoaded + 1);
+    QCOMPARE(db.mimeTypeForFile(QLatin1String("foo.ymu"), QMimeDatabase::MatchExtension).name(),
+             QString::fromLatin1("text/x-suse-ymu"));
+    checkHasMimeType("text/x-suse-ymp");
+
+    // Replaced by a file of the same size, as package managers do, most likely
+    // within the same second: the snapshot of the previous contents must not be used
+    QVERIFY(QFile::rename(destFile, movedFile));
+    QVERIFY(!db.mimeTypeForName(QLatin1String("text/x-suse-ymp")).isValid());
+    QFile file(movedFile);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QByteArray contents = file.readAll();
+    file.close();
+    contents.replace("*.ymu", "*.ymv");
+    QFile newFile(movedFile + QLatin1String(".new"));
+    QVERIFY(newFile.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    QCOMPARE(newFile.write(contents), qint64(contents.size()));
+    newFile.close();
+    QVERIFY(QFile::remove(movedFile));
+    const int snapshotsLoadedBeforeChange = qmime_xmlSnapshotsLoaded;
+    QVERIFY(QFile::rename(newFile.fileName(), destFile));
+    QCOMPARE(db.mimeTypeForFile(QLatin1String("foo.ymv"), QMimeDatabase::MatchExtension).name(),
+             QString::fromLatin1("text/x-suse-ymu"));
+    QCOMPARE(qmime_xmlSnapshotsLoaded, snapshotsLoadedBeforeChange);
+
+    QFile::remove(destFile);
+    QVERIFY(!db.mimeTypeForName(QLatin1String("text/x-suse-ymp")).isValid());
+}
+
+void tst_QMimeDatabase::packagesOverrideInOrder()
+{
+    if (qgetenv("QT_NO_MIME_CACHE").isEmpty())
+        QSKIP("The package files are only parsed by the XML provider", SkipAll);
+
+    qmime_secondsBetweenChecks = 0;
+
+    // Enough files to be parsed in parallel; the last one must still win
+    const int fileCount = 8;
+    const QString destDir = m_localXdgDir + QLatin1String("/mime/packages/");
+    QDir().mkpath(destDir);
+    QStringList destFiles;
+    for (int i = 0; i < fileCount; ++i) {
+        const QString xml = QString::fromLatin1(
+                "<?xml version=\"1.0\"?>\n"
+                "<mime-info xmlns=\"http://www.freedesktop.org/standards/shared-mime-info\">\n"
+                "  <mime-type type=\"application/x-qmime-order\"><glob pattern=\"*.order%1\"/></mime-type>\n"
+                "  <mime-type type=\"application/x-qmime-order%1\"><alias type=\"application/x-qmime-order-alias\"/></mime-type>\n"
+                "</mime-info>\n").arg(i);
+        QFile file(destDir + QString::fromLatin1("order-%1.xml").arg(i));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(xml.toUtf8());
+        destFiles.append(file.fileName());
+    }
+
+    QMimeDatabase db;
+    const QString last = QString::number(fileCount - 1);
+    QCOMPARE(db.mimeTypeForName(QLatin1String("application/x-qmime-order")).globPatterns(),
+             QStringList() << QLatin1String("*.order") + last);
+    QCOMPARE(db.mimeTypeForName(QLatin1String("application/x-qmime-order-alias")).name(),
+             QLatin1String("application/x-qmime-order") + last);
+
+    foreach (const QString &file, destFiles)
+        QFile::remove(file);
+    QVERIFY(!db.mimeTypeForName(QLatin1String("application/x-qmime-order")).isValid());
+}
+
+void tst_QMimeDatabase::builtinDatabase()
+{
+    if (qgetenv("QT_NO_MIME_CACHE").isEmpty())
+        QSKIP("The built-in database is only used by the XML provider", SkipAll);
+
+    qmime_secondsBetweenChecks = 0;
+
+    // Without any freedesktop.org.xml installed, the one built into the library is used
+    const QString emptyXdgDir = m_temporaryDir.path() + QLatin1String("/empty");
+    QVERIFY(QDir().mkpath(emptyXdgDir));
+    qputenv("XDG_DATA_DIRS", QFile::encodeName(emptyXdgDir));
+    qputenv("XDG_DATA_HOME", QFile::encodeName(emptyXdgDir));
+
+    QMimeDatabase db;
+    QVERIFY(db.mimeTypeForName(QLatin1String("text/plain")).isValid());
+    QVERIFY(db.mimeTypeForName(QLatin1String("text/x-csrc")).inherits(QLatin1String("text/plain")));
+    QCOMPARE(db.mimeTypeForName(QLatin1String("application/x-pdf")).name(), QString::fromLatin1("application/pdf"));
+    QCOMPARE(db.mimeTypeForFile(QLatin1String("foo.png"), QMimeDatabase::MatchExtension).name(),
+             QString::fromLatin1("image/png"));
+    QCOMPARE(db.mimeTypeForData(QByteArray("%PDF-1.4")).name(), QString::fromLatin1("application/pdf"));
+
+    qputenv("XDG_DATA_DIRS", QFile::encodeName(m_globalXdgDir));
+    qputenv("XDG_DATA_HOME", QFile::encodeName(m_localXdgDir));
+    QVERIFY(db.mimeTypeForName(QLatin1String("text/plain")).isValid());
+}
+
+void tst_QMimeDatabase::generatedMimeCache()
+{
+#ifndef Q_OS_UNIX
+    QSKIP("The binary provider needs mmap", SkipAll);
+#endif
+    if (qgetenv("QT_NO_MIME_CACHE").isEmpty())
+        QSKIP("Only used without a system mime.cache, i.e. by the XML provider", SkipAll);
+
+    qmime_secondsBetweenChecks = 0;
+    qputenv("QT_NO_MIME_CACHE", "");
+
+    QMimeDatabase db;
+    const QString destDir = m_localXdgDir + QLatin1String("/mime/packages/");
+    QDir().mkpath(destDir);
+    const QString destFile = destDir + QLatin1String(yastFileName);
+    const QString movedFile = m_temporaryDir.path() + QLatin1Char('/') + QLatin1String(yastFileName);
+    QFile::remove(destFile);
+    QFile::remove(movedFile);
+
+    // Parsed, and compiled into a mime.cache for next time
+    QVERIFY(QFile::copy(m_yastMimeTypes, destFile));
+    QVERIFY(db.mimeTypeForName(QLatin1String("text/x-suse-ymp")).isValid());
+
+    QVERIFY(QFile::rename(destFile, movedFile));
+    QVERIFY(!db.mimeTypeForName(QLatin1String("text/x-suse-ymp")).isValid());
+    const int cachesLoaded = qmime_generatedCachesLoaded;
+
+    // Same files as before: mapped by the binary provider, with the same results
+    QVERIFY(QFile::rename(movedFile, destFile));
+    QVERIFY(db.mimeTypeForName(QLatin1String("text/x-suse-ymp")).isValid());
+    QCOMPARE(qmime_generatedCachesLoaded, cachesLoaded + 1);
+    checkHasMimeType("text/x-suse-ymp");
+    QCOMPARE(db.mimeTypeForFile(QLatin1String("foo.ymu"), QMimeDatabase::MatchExtension).name(),
+             QString::fromLatin1("text/x-suse-ymu"));
+    QCOMPARE(db.mimeTypeForFile(QLatin1String("foo.png"), QMimeDatabase::MatchExtension).name(),
+             QString::fromLatin1("image/png"));
+    QCOMPARE(db.mimeTypeForFile(QLatin1String("Makefile"), QMimeDatabase::MatchExtension).name(),
+             QString::fromLatin1("text/x-makefile"));
+    // Case-insensitive globs that aren't lowercase in the XML: *.Z, *.tar.Z, *.BLEND
+    QCOMPARE(db.mimeTypeForFile(QLatin1String("foo.tar.Z"), QMimeDatabase::MatchExtension).name(),
+             QString::fromLatin1("application/x-tarz"));
+    QCOMPARE(db.mimeTypeForFile(QLatin1String("foo.blend"), QMimeDatabase::MatchExtension).name(),
+             QString::fromLatin1("application/x-blender"));
+    QCOMPARE(db.mimeTypeForFile(QLatin1String("foo.BLEND"), QMimeDatabase::MatchExtension).name(),
+             QString::fromLatin1("application/x-blender"));
+    QCOMPARE(db.mimeTypeForData(QByteArray("%PDF-1.4")).name(), QString::fromLatin1("application/pdf"));
+    QCOMPARE(db.mimeTypeForName(QLatin1String("application/x-pdf")).name(), QString::fromLatin1("application/pdf"));
+    QVERIFY(db.mimeTypeForName(QLatin1String("text/x-csrc")).inherits(QLatin1String("text/plain")));
+    QVERIFY(db.mimeTypeForName(QLatin1String("text/x-csrc")).globPatterns().contains(QLatin1String("*.c")));
+    QVERIFY(!db.mimeTypeForName(QLatin1String("text/x-csrc")).comment().isEmpty());
+
+    QFile::remove(destFile);
+    qputenv("QT_NO_MIME_CACHE", "1");
+    QVERIFY(!db.mimeTypeForName(QLatin1String("text/x-suse-ymp")).isValid());
+}
+
 #define QTEST_GUILESS_MAIN(TestObject) \
 int main(int argc, char *argv[]) \
 { \
@@ -55,13 +55,17 @@ public:
 
 private slots:
     void initTestCase();
+    void cleanup();
 
     void mimeTypeForName();
     void mimeTypeForFileName_data();
     void mimeTypeForFileName();
     void mimeTypesForFileName_data();
     void mimeTypesForFileName();
+    void mimeTypesForFileNames();
+    void mimeTypesForFileNamesPerformance();
     void inheritance();
+    void inheritsAllAncestors();
     void aliases();
     void icons();
     void mimeTypeForFileWithContent();
@@ -72,10 +76,14 @@ private slots:
     void mimeTypeForFileAndContent();
     void allMimeTypes();
     void inheritsPerformance();
+    void allAncestorsPerformance();
+    void commentPerformance();
     void suffixes_data();
     void suffixes();
     void knownSuffix();
     void fromThreads();
+    void fromThreadsBenchmark_data();
+    void fromThreadsBenchmark();
 
     // shared-mime-info test suite
 
@@ -85,13 +93,23 @@ private slots:
     void findByData_data();
     void findByData();
 
+    void findByDataSniffer_data();
+    void findByDataSniffer();
+
     void findByFile_data();
     void findByFile();
 
+    void magicDispatchIndex();
+
     //
 
     void installNewGlobalMimeType();
     void installNewLocalMimeType();
+    void watchMimeDirectories();
+    void xmlSnapshot();
+    void packagesOverrideInOrder();
+    void builtinDatabase();
+    void generatedMimeCache();
 
 private:
     void init(); // test-specific
@@ -101,6 +119,7 @@ private:
     QString m_yastMimeTypes;
     QDir m_temporaryDir;
     QString m_testSuite;
+    int m_maxThreadCount;
 };
 
 #endif   // TST_QMIMEDATABASE_H
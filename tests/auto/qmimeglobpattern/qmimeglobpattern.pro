@@ -0,0 +1,24 @@
+include(../../../mimetypes-nolibs.pri)
+
+TEMPLATE = app
+
+TARGET   = tst_qmimeglobpattern
+CONFIG   += qtestlib
+CONFIG   -= app_bundle
+
+DEPENDPATH += .
+
+*-g++*:QMAKE_CXXFLAGS += -W -Wall -Wshadow -Wnon-virtual-dtor
+
+CONFIG += depend_includepath
+
+
+SOURCES += tst_qmimeglobpattern.cpp \
+           ../../../src/mimetypes/qmimeglobpattern.cpp
+
+HEADERS += tst_qmimeglobpattern.h
+
+
+QMAKE_EXTRA_TARGETS += check
+check.depends = $$TARGET
+check.commands = ./$$TARGET
@@ -0,0 +1,242 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "tst_qmimeglobpattern.h"
+
+#include <qmimeglobpattern_p.h>
+
+#include <QtTest/QtTest>
+
+Q_DECLARE_METATYPE(QMimeGlobPattern::PatternType)
+
+// ------------------------------------------------------------------------------------------------
+
+void tst_qmimeglobpattern::patternType_data()
+{
+    QTest::addColumn<QString>("pattern");
+    QTest::addColumn<QMimeGlobPattern::PatternType>("type");
+
+    QTest::newRow("literal") << "Makefile" << QMimeGlobPattern::LiteralPattern;
+    QTest::newRow("suffix") << "*.txt" << QMimeGlobPattern::SuffixPattern;
+    QTest::newRow("backup") << "*~" << QMimeGlobPattern::SuffixPattern;
+    QTest::newRow("prefix") << "README*" << QMimeGlobPattern::PrefixPattern;
+    QTest::newRow("contains") << "*core*" << QMimeGlobPattern::ContainsPattern;
+    QTest::newRow("set") << "*.anim[1-9j]" << QMimeGlobPattern::WildcardPattern;
+    QTest::newRow("any char") << "*.r?" << QMimeGlobPattern::WildcardPattern;
+    QTest::newRow("two stars") << "lib*.so.*" << QMimeGlobPattern::WildcardPattern;
+}
+
+void tst_qmimeglobpattern::patternType()
+{
+    QFETCH(QString, pattern);
+    QFETCH(QMimeGlobPattern::PatternType, type);
+
+    const QMimeGlobPattern glob(pattern, QLatin1String("application/x-test"));
+    QCOMPARE(int(glob.patternType()), int(type));
+}
+
+// ------------------------------------------------------------------------------------------------
+
+void tst_qmimeglobpattern::matchFileName_data()
+{
+    QTest::addColumn<QString>("pattern");
+    QTest::addColumn<bool>("caseSensitive");
+    QTest::addColumn<QString>("fileName");
+    QTest::addColumn<bool>("expected");
+
+    QTest::newRow("literal") << "Makefile" << false << "makefile" << true;
+    QTest::newRow("literal, case-sensitive") << "Makefile" << true << "makefile" << false;
+    QTest::newRow("literal, longer") << "Makefile" << false << "Makefile.am" << false;
+    QTest::newRow("suffix") << "*.txt" << false << "README.TXT" << true;
+    QTest::newRow("suffix, case-sensitive") << "*.C" << true << "foo.c" << false;
+    QTest::newRow("suffix, too short") << "*.txt" << false << "txt" << false;
+    QTest::newRow("suffix, exact") << "*.txt" << false << ".txt" << true;
+    QTest::newRow("prefix") << "README*" << false << "readme.first" << true;
+    QTest::newRow("prefix, no match") << "README*" << false << "xREADME" << false;
+    QTest::newRow("contains") << "*core*" << false << "libcore.so" << true;
+    QTest::newRow("contains, no match") << "*core*" << false << "libcor.so" << false;
+    QTest::newRow("star only") << "*" << false << "anything" << true;
+    QTest::newRow("set, range") << "*.anim[1-9j]" << false << "foo.anim5" << true;
+    QTest::newRow("set, char") << "*.anim[1-9j]" << false << "foo.ANIMJ" << true;
+    QTest::newRow("set, no match") << "*.anim[1-9j]" << false << "foo.anim0" << false;
+    QTest::newRow("negated set") << "*.[!a]" << false << "foo.b" << true;
+    QTest::newRow("negated set, no match") << "*.[!a]" << false << "foo.a" << false;
+    QTest::newRow("bracket in set") << "[]x]" << false << "]" << true;
+    QTest::newRow("any char") << "*.r??" << false << "foo.rar" << true;
+    QTest::newRow("any char, too short") << "*.r??" << false << "foo.ra" << false;
+    QTest::newRow("escape") << "\\*.txt" << false << "*.txt" << true;
+    QTest::newRow("escape, no match") << "\\*.txt" << false << "a.txt" << false;
+    QTest::newRow("backtracking") << "*a*b*c" << false << "xaxbxbxc" << true;
+    QTest::newRow("backtracking, no match") << "*a*b*c" << false << "xaxbxbxcx" << false;
+    QTest::newRow("two stars") << "lib*.so.*" << false << "libfoo.so.1" << true;
+}
+
+void tst_qmimeglobpattern::matchFileName()
+{
+    QFETCH(QString, pattern);
+    QFETCH(bool, caseSensitive);
+    QFETCH(QString, fileName);
+    QFETCH(bool, expected);
+
+    const QMimeGlobPattern glob(pattern, QLatin1String("application/x-test"), QMimeGlobPattern::DefaultWeight,
+                                caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
+    QCOMPARE(glob.matchFileName(fileName), expected);
+
+    // The precompiled matcher must agree with QRegExp, which was used before
+    const QRegExp rx(glob.pattern(), Qt::CaseSensitive, QRegExp::WildcardUnix);
+    QCOMPARE(rx.exactMatch(caseSensitive ? fileName : fileName.toLower()), expected);
+}
+
+void tst_qmimeglobpattern::matchingGlobs_data()
+{
+    QTest::addColumn<QString>("fileName");
+    QTest::addColumn<QStringList>("expectedMimeTypes");
+    QTest::addColumn<QString>("expectedSuffix");
+
+    QTest::newRow("simple suffix") << "foo.txt" << (QStringList() << "text/plain") << "txt";
+    QTest::newRow("suffix, other case") << "FOO.TXT" << (QStringList() << "text/plain") << "txt";
+    QTest::newRow("two mimetypes") << "foo.doc" << (QStringList() << "application/msword" << "text/x-doc") << "doc";
+    QTest::newRow("longer suffix wins") << "foo.tar.bz2" << (QStringList() << "application/x-bzip-compressed-tar") << "tar.bz2";
+    QTest::newRow("shorter suffix") << "foo.bz2" << (QStringList() << "application/x-bzip") << "bz2";
+    QTest::newRow("higher weight wins") << "foo.tar.gz" << (QStringList() << "application/x-gzip") << "gz";
+    QTest::newRow("case-sensitive suffix") << "foo.C" << (QStringList() << "text/x-c++src") << "C";
+    QTest::newRow("case-sensitive suffix, other case") << "foo.c" << (QStringList() << "text/x-csrc") << "c";
+    QTest::newRow("suffix without dot") << "foo~" << (QStringList() << "application/x-trash") << QString();
+    QTest::newRow("suffix beats prefix") << "README.txt" << (QStringList() << "text/plain") << "txt";
+    QTest::newRow("prefix") << "README.foo" << (QStringList() << "text/x-readme") << QString();
+    QTest::newRow("wildcard") << "foo.anim5" << (QStringList() << "video/x-anim") << "anim[1-9j]";
+    QTest::newRow("literal") << "makefile" << (QStringList() << "text/x-makefile") << QString();
+    QTest::newRow("case-sensitive literal") << "core" << (QStringList() << "application/x-core") << QString();
+    QTest::newRow("case-sensitive literal, other case") << "Core" << QStringList() << QString();
+    QTest::newRow("literal is not a suffix") << "my-core" << QStringList() << QString();
+    QTest::newRow("no match") << "foo.xyz" << QStringList() << QString();
+}
+
+void tst_qmimeglobpattern::matchingGlobs()
+{
+    QFETCH(QString, fileName);
+    QFETCH(QStringList, expectedMimeTypes);
+    QFETCH(QString, expectedSuffix);
+
+    QMimeAllGlobPatterns globs;
+    globs.addGlob(QMimeGlobPattern(QLatin1String("*.txt"), QLatin1String("text/plain")));
+    globs.addGlob(QMimeGlobPattern(QLatin1String("*.doc"), QLatin1String("application/msword")));
+    globs.addGlob(QMimeGlobPattern(QLatin1String("*.doc"), QLatin1String("text/x-doc")));
+    globs.addGlob(QMimeGlobPattern(QLatin1String("*.bz2"), QLatin1String("application/x-bzip")));
+    globs.addGlob(QMimeGlobPattern(QLatin1String("*.tar.bz2"), QLatin1String("application/x-bzip-compressed-tar")));
+    globs.addGlob(QMimeGlobPattern(QLatin1String("*.tar.gz"), QLatin1String("application/x-compressed-tar"), 40));
+    globs.addGlob(QMimeGlobPattern(QLatin1String("*.gz"), QLatin1String("application/x-gzip"), 60));
+    globs.addGlob(QMimeGlobPattern(QLatin1String("*.C"), QLatin1String("text/x-c++src"), 50, Qt::CaseSensitive));
+    globs.addGlob(QMimeGlobPattern(QLatin1String("*.c"), QLatin1String("text/x-csrc"), 50, Qt::CaseSensitive));
+    globs.addGlob(QMimeGlobPattern(QLatin1String("*~"), QLatin1String("application/x-trash")));
+    globs.addGlob(QMimeGlobPattern(QLatin1String("README*"), QLatin1String("text/x-readme"), 10));
+    globs.addGlob(QMimeGlobPattern(QLatin1String("*.anim[1-9j]"), QLatin1String("video/x-anim")));
+    globs.addGlob(QMimeGlobPattern(QLatin1String("Makefile"), QLatin1String("text/x-makefile")));
+    globs.addGlob(QMimeGlobPattern(QLatin1String("core"), QLatin1String("application/x-core"), 50, Qt::CaseSensitive));
+
+    QString foundSuffix;
+    QCOMPARE(globs.matchingGlobs(fileName, &foundSuffix), expectedMimeTypes);
+    QCOMPARE(foundSuffix, expectedSuffix);
+}
+
+void tst_qmimeglobpattern::matchFileNameBenchmark()
+{
+    QMimeGlobPatternList globs;
+    globs.append(QMimeGlobPattern(QLatin1String("*.anim[1-9j]"), QLatin1String("video/x-anim")));
+    globs.append(QMimeGlobPattern(QLatin1String("README*"), QLatin1String("text/x-readme"), 10));
+    globs.append(QMimeGlobPattern(QLatin1String("*~"), QLatin1String("application/x-trash")));
+    globs.append(QMimeGlobPattern(QLatin1String("core"), QLatin1String("application/x-core")));
+    globs.append(QMimeGlobPattern(QLatin1String("*.tar.bz2"), QLatin1String("application/x-bzip-compressed-tar")));
+    globs.append(QMimeGlobPattern(QLatin1String("*.[1-9]"), QLatin1String("text/troff")));
+
+    const QMimeGlobLookupContext context(QLatin1String("Some-Document.With.A.Long.Name.odt"));
+    QBENCHMARK {
+        QMimeGlobMatchResult result;
+        globs.match(result, context);
+        QVERIFY(result.m_matchingMimeTypes.isEmpty());
+    }
+}
+
+void tst_qmimeglobpattern::matchingGlobsBenchmark_data()
+{
+    QTest::addColumn<int>("globCount");
+
+    QTest::newRow("10") << 10;
+    QTest::newRow("100") << 100;
+    QTest::newRow("1000") << 1000;
+}
+
+void tst_qmimeglobpattern::matchingGlobsBenchmark()
+{
+    QFETCH(int, globCount);
+
+    // Case-insensitive suffix globs of several weights, which go to the suffix tree,
+    // and prefix globs, which are scanned linearly. The file name is lowercased once
+    // per lookup, not once per glob.
+    QMimeAllGlobPatterns globs;
+    for (int i = 0; i < globCount; ++i) {
+        const QString n = QString::number(i);
+        globs.addGlob(QMimeGlobPattern(QLatin1String("*.Tar.") + n, QLatin1String("application/x-") + n, 40));
+        globs.addGlob(QMimeGlobPattern(QLatin1String("*.") + n, QLatin1String("application/x-") + n));
+        globs.addGlob(QMimeGlobPattern(QLatin1String("Core.") + n + QLatin1Char('*'), QLatin1String("application/x-") + n, 30));
+    }
+
+    const QString fileName = QLatin1String("A-Rather-Long-Name-For-A-File-Which-Matches-No-Glob.Tar.XZ");
+    QStringList result;
+    QBENCHMARK {
+        result = globs.matchingGlobs(fileName, 0);
+    }
+    QVERIFY(result.isEmpty());
+}
+
+// ------------------------------------------------------------------------------------------------
+
+#if (QT_VERSION < QT_VERSION_CHECK(5, 0, 0))
+#define QTEST_GUILESS_MAIN(TestObject) \
+int main(int argc, char *argv[]) \
+{ \
+    QCoreApplication app(argc, argv); \
+    TestObject tc; \
+    return QTest::qExec(&tc, argc, argv); \
+}
+#endif
+
+QTEST_GUILESS_MAIN(tst_qmimeglobpattern)
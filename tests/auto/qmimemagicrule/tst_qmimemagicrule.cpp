@@ -0,0 +1,160 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "tst_qmimemagicrule.h"
+
+#include <qmimemagicsubstring_p.h>
+
+#include <QtTest/QtTest>
+
+Q_DECLARE_METATYPE(QMimeMagicSubstringKernel)
+
+// ------------------------------------------------------------------------------------------------
+
+static void addKernelRows()
+{
+    QTest::addColumn<QMimeMagicSubstringKernel>("kernel");
+
+    QTest::newRow("sse2") << QMimeMagicSse2Kernel;
+    QTest::newRow("avx2") << QMimeMagicAvx2Kernel;
+}
+
+static QByteArray randomBytes(int size, int alphabet)
+{
+    QByteArray result(size, Qt::Uninitialized);
+    for (int i = 0; i < size; ++i)
+        result[i] = char(qrand() % alphabet);
+    return result;
+}
+
+void tst_qmimemagicrule::matchSubstringKernels_data()
+{
+    addKernelRows();
+}
+
+void tst_qmimemagicrule::matchSubstringKernels()
+{
+    QFETCH(QMimeMagicSubstringKernel, kernel);
+
+    const QMimeMagicSubstringMatcher matcher = qmime_substringMatcher(kernel);
+    if (!matcher)
+        QSKIP("Kernel not supported by this compiler or CPU", SkipSingle);
+    const QMimeMagicSubstringMatcher scalar = qmime_substringMatcher(QMimeMagicScalarKernel);
+
+    // A small alphabet makes partial and full matches frequent
+    qsrand(42);
+    for (int i = 0; i < 20000; ++i) {
+        const int alphabet = 1 + qrand() % 4;
+        const QByteArray data = randomBytes(qrand() % 300, alphabet);
+        const int valueLength = qrand() % 6;
+        const QByteArray value = randomBytes(valueLength, alphabet);
+        QByteArray mask(valueLength, char(0xff));
+        for (int j = 0; j < valueLength; ++j) {
+            if (qrand() % 3 == 0)
+                mask[j] = char(0xfe);
+        }
+        const char *maskPtr = (qrand() % 2) ? mask.constData() : 0;
+        const int rangeStart = qrand() % (data.size() + 5);
+        const int rangeLength = 1 + qrand() % 300;
+
+        const bool expected = scalar(data.constData(), data.size(), rangeStart, rangeLength,
+                                     valueLength, value.constData(), maskPtr);
+        const bool actual = matcher(data.constData(), data.size(), rangeStart, rangeLength,
+                                    valueLength, value.constData(), maskPtr);
+        if (actual != expected) {
+            qDebug() << "data" << data.toHex() << "value" << value.toHex()
+                     << "mask" << (maskPtr ? mask.toHex() : QByteArray()) << "range" << rangeStart << rangeLength;
+            QCOMPARE(actual, expected);
+        }
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+
+void tst_qmimemagicrule::matchSubstringBenchmark_data()
+{
+    QTest::addColumn<QMimeMagicSubstringKernel>("kernel");
+    QTest::addColumn<bool>("masked");
+
+    QTest::newRow("scalar") << QMimeMagicScalarKernel << false;
+    QTest::newRow("scalar-masked") << QMimeMagicScalarKernel << true;
+    QTest::newRow("sse2") << QMimeMagicSse2Kernel << false;
+    QTest::newRow("sse2-masked") << QMimeMagicSse2Kernel << true;
+    QTest::newRow("avx2") << QMimeMagicAvx2Kernel << false;
+    QTest::newRow("avx2-masked") << QMimeMagicAvx2Kernel << true;
+}
+
+void tst_qmimemagicrule::matchSubstringBenchmark()
+{
+    QFETCH(QMimeMagicSubstringKernel, kernel);
+    QFETCH(bool, masked);
+
+    const QMimeMagicSubstringMatcher matcher = qmime_substringMatcher(kernel);
+    if (!matcher)
+        QSKIP("Kernel not supported by this compiler or CPU", SkipSingle);
+
+    // Like offset="0:256" rules looking for a value which isn't there
+    qsrand(42);
+    const QByteArray data = randomBytes(16384, 256);
+    const QByteArray value("<?xml version=");
+    const QByteArray mask(value.size(), char(0xdf));
+    const char *maskPtr = masked ? mask.constData() : 0;
+    bool found = false;
+    QBENCHMARK {
+        for (int rangeStart = 0; rangeStart < 4096; rangeStart += 256)
+            found |= matcher(data.constData(), data.size(), rangeStart, 256, value.size(), value.constData(), maskPtr);
+    }
+    QVERIFY(!found);
+}
+
+// ------------------------------------------------------------------------------------------------
+
+#if (QT_VERSION < QT_VERSION_CHECK(5, 0, 0))
+#define QTEST_GUILESS_MAIN(TestObject) \
+int main(int argc, char *argv[]) \
+{ \
+    QCoreApplication app(argc, argv); \
+    TestObject tc; \
+    return QTest::qExec(&tc, argc, argv); \
+}
+#endif
+
+QTEST_GUILESS_MAIN(tst_qmimemagicrule)